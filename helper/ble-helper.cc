@@ -24,6 +24,9 @@
  */
 #include "ble-helper.h"
 #include <ns3/ble-module.h>
+#include <ns3/ble-spectrum-channel.h>
+#include <ns3/ble-anchor-allocator.h>
+#include <ns3/boolean.h>
 #include <ns3/packet.h>
 #include <ns3/mobility-model.h>
 #include <ns3/single-model-spectrum-channel.h>
@@ -79,7 +82,11 @@ AsciiBleMacTransmitSinkWithoutContext (
 
 BleHelper::BleHelper (void)
 {
-  m_channel = CreateObject<MultiModelSpectrumChannel> ();
+  // The default propagation loss below is deterministic, so far away 
+  // receivers can be skipped and the path losses of static pairs reused.
+  m_channel = CreateObject<BleSpectrumChannel> ();
+  m_channel->SetAttribute ("SpatialIndex", BooleanValue (true));
+  m_channel->SetAttribute ("CachePathLoss", BooleanValue (true));
 
   Ptr<LogDistancePropagationLossModel> lossModel = 
     CreateObject<LogDistancePropagationLossModel> ();
@@ -88,15 +95,12 @@ BleHelper::BleHelper (void)
   Ptr<ConstantSpeedPropagationDelayModel> delayModel = 
     CreateObject<ConstantSpeedPropagationDelayModel> ();
   m_channel->SetPropagationDelayModel (delayModel);
-	m_spectrumModel = 0;
-  ConstructAllChannels();
 }
 
 BleHelper::~BleHelper (void)
 {
   m_channel->Dispose ();
   m_channel = 0;
-	m_spectrumModel = 0;
 }
 
 void
@@ -117,6 +121,7 @@ BleHelper::EnableLogComponents (void)
     LogComponentEnable ("BleLinkManager", LOG_LEVEL_ALL);
     LogComponentEnable ("BleLink", LOG_LEVEL_ALL);
     LogComponentEnable ("BlePhy", LOG_LEVEL_ALL);
+    LogComponentEnable ("BleSpectrumChannel", LOG_LEVEL_ALL);
     LogComponentEnable ("BleApplication", LOG_LEVEL_ALL);
     LogComponentEnable ("BleHelper", LOG_LEVEL_ALL);
    // LogComponentEnable ("BleMacHeader", LOG_LEVEL_ALL);
@@ -133,6 +138,7 @@ BleHelper::EnableLogComponents (void)
    // LogComponentEnable ("BleLinkManager", LOG_FUNCTION);
     LogComponentEnable ("BleLink", LOG_LEVEL_WARN);
     LogComponentEnable ("BlePhy", LOG_LEVEL_WARN);
+    LogComponentEnable ("BleSpectrumChannel", LOG_LEVEL_WARN);
     LogComponentEnable ("BleApplication", LOG_LEVEL_WARN);
     LogComponentEnable ("BleHelper", LOG_LEVEL_WARN);
   }
@@ -148,6 +154,7 @@ BleHelper::EnableLogComponents (void)
     LogComponentEnable ("BleLinkManager", LOG_LOGIC);
     LogComponentEnable ("BleLink", LOG_LEVEL_INFO);
     LogComponentEnable ("BlePhy", LOG_LEVEL_INFO);
+    LogComponentEnable ("BleSpectrumChannel", LOG_LEVEL_INFO);
     LogComponentEnable ("BleApplication", LOG_LEVEL_INFO);
     LogComponentEnable ("BleHelper", LOG_LEVEL_INFO);
    // LogComponentEnable ("BleMacHeader", LOG_LEVEL_ALL);
@@ -162,60 +169,6 @@ BleHelper::AddMobility (Ptr<BlePhy> phy, Ptr<MobilityModel> m)
 }
 
 
-void
-BleHelper::ConstructAllChannels()
-{
-    SpectrumChannelHelper channelHelper;
-    channelHelper.SetChannel("ns3::MultiModelSpectrumChannel");
-
-    channelHelper.AddPropagationLoss("ns3::LogDistancePropagationLossModel"
-        // "ReferenceDistance", DoubleValue(1.0),
-        // "ReferenceLoss", DoubleValue(47.0),
-        // "Exponent", DoubleValue(3.0),
-        // "Frequency", DoubleValue(2410e6)
-        );
-
-    // channelHelper.AddPropagationLoss("ns3::NakagamiPropagationLossModel",
-    //     "m0", DoubleValue(1), "m1", DoubleValue(1), "m2", DoubleValue(1));
-
-  channelHelper.SetPropagationDelay("ns3::ConstantSpeedPropagationDelayModel");
-    
-    
-    for (int i = 0; i < 40; i++)
-    {
-        Ptr<SpectrumChannel> c = channelHelper.Create();
-        m_allChannels.push_back(c);
-    }
-}
-
-
-// void
-// BleHelper::ConstructAllChannels()
-// {
-//     SpectrumChannelHelper channelHelper;
-//     channelHelper.SetChannel ("ns3::MultiModelSpectrumChannel");
-//     bool nakagami = false;
-//     if (nakagami)
-//     {
-//     	channelHelper.AddPropagationLoss ("ns3::OkumuraHataPropagationLossModel",
-//             "Frequency",DoubleValue(2400e6));
-//      	channelHelper.AddPropagationLoss ("ns3::NakagamiPropagationLossModel",
-//             "m0",DoubleValue(1),"m1",DoubleValue(1),"m2",DoubleValue(1));
-//     }
-//     else
-//     {
-//       channelHelper.AddPropagationLoss ("ns3::OkumuraHataPropagationLossModel",
-//           "Frequency",DoubleValue(2400e6));
-//     }
-//     channelHelper.SetPropagationDelay ("ns3::ConstantSpeedPropagationDelayModel");
-    
-//   for (int i=0; i<40; i++)
-//   {
-//     Ptr<SpectrumChannel> c = channelHelper.Create ();
-//     m_allChannels.push_back(c);
-//   }
-// }
-
 NetDeviceContainer
 BleHelper::Install (NodeContainer c)
 {
@@ -228,21 +181,18 @@ BleHelper::Install (NodeContainer c)
 		devices.Add(anandi);
 		Ptr<BlePhy> sfp = Create<BlePhy> ();
         Ptr<BleLinkController> blc = CreateObject<BleLinkController> ();
-		if (!m_spectrumModel)
-			m_spectrumModel = sfp->GetRxSpectrumModel();
-		else
-			sfp->SetRxSpectrumModel (m_spectrumModel);
 		anandi->SetPhy (sfp);
         anandi->SetLinkController (blc);
 		anandi->SetAddress(Mac16Address::Allocate());
         blc->SetNetDevice (anandi);
-        blc->SetAllChannels (m_allChannels);
 		sfp->SetDevice(anandi);
 		sfp->SetMobility (nodeI->GetObject<MobilityModel> ());
 		sfp->SetChannel (m_channel);
 		sfp->SetRxAntenna (Create<IsotropicAntennaModel> ());
 		nodeI->AddDevice(anandi);
-		anandi->SetGenericPhyTxStartCallback (MakeCallback(&BlePhy::StartTx,sfp));
+		// BlePhy::StartTx takes a const packet
+		anandi->SetGenericPhyTxStartCallback (GenericPhyTxStartCallback (
+            [sfp] (Ptr<Packet> packet) { return sfp->StartTx (packet); }));
 		sfp->SetTransmissionEndCallback( 
             MakeCallback(&BleNetDevice::NotifyTransmissionEnd,anandi));
 		sfp->SetReceptionEndCallback ( 
@@ -299,7 +249,7 @@ BleHelper::AssignStreams (NetDeviceContainer c, int64_t stream)
       Ptr<BleNetDevice> Ble = DynamicCast<BleNetDevice> (netDevice);
       if (Ble)
         {
-          //currentStream += Ble->AssignStreams (currentStream);
+          currentStream += Ble->AssignStreams (currentStream);
         }
     }
   return (currentStream - stream);
@@ -626,7 +576,27 @@ BleHelper::CreateAllLinks (NetDeviceContainer c,
     bool scheduled, uint32_t nbConnInterval)
 {
   NS_LOG_FUNCTION (this);
-  uint32_t nbOffset = 0;
+  // In scheduled mode, the offsets come from the anchor allocator so that
+  // no device has two overlapping transmit windows
+  BleAnchorAllocator allocator;
+  if (scheduled)
+    {
+      for (uint32_t i = 0; i < c.GetN (); i++)
+        {
+          for (uint32_t j = i+1; j < c.GetN (); j++)
+            {
+              allocator.AddLink (i, j);
+            }
+        }
+      if (!allocator.Allocate (nbConnInterval))
+        {
+          NS_LOG_WARN ("Transmit windows of " << c.GetN () << " devices "
+              "will overlap, expect skipped windows");
+        }
+      nbConnInterval = allocator.GetConnInterval ();
+    }
+
+  uint32_t nbLink = 0;
   for (NetDeviceContainer::Iterator i = c.Begin (); i != c.End (); ++i)
     {
       Ptr<NetDevice> netDevice = (*i);
@@ -635,11 +605,12 @@ BleHelper::CreateAllLinks (NetDeviceContainer c,
       {
         Ptr<NetDevice> netDevice2 = (*j);
         Ptr<BleNetDevice> BleND2 = DynamicCast<BleNetDevice> (netDevice2);
+        uint32_t nbOffset = scheduled ? allocator.GetOffset (nbLink) : nbLink;
         Ptr<BleLink> link2 = BleND1->GetBBManager()->CreateLinkScheduled(
           BleND2->GetBBManager(), 
           BleLinkManager::Role::MASTER_ROLE, 
           scheduled, nbOffset, nbConnInterval);
-        nbOffset++;
+        nbLink++;
       }
  
     }
@@ -135,7 +135,8 @@ namespace ns3 {
      * Assign a fixed random variable stream number to the random variables
      * used by this model. Return the number of streams that have been
      * assigned. The Install() method should have previously been
-     * called by the user.
+     * called by the user, and the links should be created afterwards,
+     * since their access addresses are drawn when they are set up.
      *
      * \param c NetDeviceContainer of the set of net devices for which the 
      *          CsmaNetDevice should be modified to use a fixed stream
@@ -148,6 +149,8 @@ namespace ns3 {
     /*
      * Creates all possible links between the devices in the container
      * (fully connected mesh)
+     * If scheduled, the window offsets are assigned by a BleAnchorAllocator
+     * and the connection interval is grown when the windows do not fit
      */
     void CreateAllLinks (NetDeviceContainer c, 
         bool scheduled, uint32_t nbConnInterval);
@@ -232,8 +235,6 @@ private:
 			Ptr<NetDevice> nd,
 			bool explicitFilename);
 
-    void ConstructAllChannels ();
-
   Ptr<SpectrumChannel> m_channel; //!< channel to be used for the devices
 	
   typedef std::tuple<std::string,CallbackBase> callbacktuple;
@@ -241,8 +242,6 @@ private:
   
   std::list<ObjectFactory> m_netApp; 
         //!< These are the applications installed on the network server
-	Ptr<const SpectrumModel> m_spectrumModel;
-  std::vector<Ptr<SpectrumChannel>> m_allChannels;
   
 
   ObjectFactory m_queueFactory;
@@ -0,0 +1,118 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ble-anchor-allocator.h"
+#include <ns3/log.h>
+#include <ns3/assert.h>
+
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("BleAnchorAllocator");
+
+const uint32_t BleAnchorAllocator::SLOTS_PER_WINDOW;
+const uint32_t BleAnchorAllocator::MAX_CONN_INTERVAL;
+
+BleAnchorAllocator::BleAnchorAllocator ()
+  : m_nOffsets (0),
+    m_connInterval (0)
+{
+}
+
+uint32_t
+BleAnchorAllocator::AddLink (uint32_t deviceA, uint32_t deviceB)
+{
+  NS_LOG_FUNCTION (this << deviceA << deviceB);
+  NS_ASSERT (deviceA != deviceB);
+  m_links.push_back (std::make_pair (deviceA, deviceB));
+  return m_links.size () - 1;
+}
+
+bool
+BleAnchorAllocator::Allocate (uint32_t nbConnInterval)
+{
+  NS_LOG_FUNCTION (this << nbConnInterval);
+  uint32_t nDevices = 0;
+  for (const auto &link : m_links)
+    {
+      nDevices = std::max (nDevices, std::max (link.first, link.second) + 1);
+    }
+
+  // Offsets already taken, per device
+  std::vector<std::vector<bool> > used (nDevices);
+  m_offsets.assign (m_links.size (), 0);
+  m_nOffsets = 0;
+  for (std::size_t i = 0; i < m_links.size (); i++)
+    {
+      std::vector<bool> &a = used[m_links[i].first];
+      std::vector<bool> &b = used[m_links[i].second];
+      uint32_t offset = 0;
+      while ((offset < a.size () && a[offset])
+             || (offset < b.size () && b[offset]))
+        {
+          offset++;
+        }
+      a.resize (std::max<std::size_t> (a.size (), offset + 1), false);
+      b.resize (std::max<std::size_t> (b.size (), offset + 1), false);
+      a[offset] = true;
+      b[offset] = true;
+      m_offsets[i] = offset;
+      m_nOffsets = std::max (m_nOffsets, offset + 1);
+    }
+
+  uint32_t needed = m_nOffsets * SLOTS_PER_WINDOW;
+  m_connInterval = std::max (nbConnInterval, needed);
+  if (needed > MAX_CONN_INTERVAL)
+    {
+      NS_LOG_WARN ("No conflict free schedule: " << m_links.size ()
+                   << " links need " << m_nOffsets << " windows of "
+                   << SLOTS_PER_WINDOW << " slots, the connection interval "
+                   "cannot exceed " << MAX_CONN_INTERVAL << " slots");
+      m_connInterval = std::max (nbConnInterval, MAX_CONN_INTERVAL);
+      return false;
+    }
+  if (m_connInterval != nbConnInterval)
+    {
+      NS_LOG_INFO ("Connection interval grown from " << nbConnInterval
+                   << " to " << m_connInterval << " slots for "
+                   << m_nOffsets << " windows");
+    }
+  return true;
+}
+
+uint32_t
+BleAnchorAllocator::GetOffset (uint32_t link) const
+{
+  NS_ASSERT (link < m_offsets.size ());
+  return m_offsets[link];
+}
+
+uint32_t
+BleAnchorAllocator::GetConnInterval (void) const
+{
+  return m_connInterval;
+}
+
+uint32_t
+BleAnchorAllocator::GetNOffsets (void) const
+{
+  return m_nOffsets;
+}
+
+} // namespace ns3
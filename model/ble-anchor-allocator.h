@@ -0,0 +1,103 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BLE_ANCHOR_ALLOCATOR_H
+#define BLE_ANCHOR_ALLOCATOR_H
+
+#include <stdint.h>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup ble
+ * \brief Assigns conflict free transmit window offsets to scheduled links
+ *
+ * All scheduled links share one connection interval. A link with window
+ * offset k (the nbTxWindowOffset of BleLinkManager::SetupLink) occupies the
+ * slots [k*SLOTS_PER_WINDOW, (k+1)*SLOTS_PER_WINDOW) of every interval,
+ * a 5 ms window followed by a guard slot. Two links of the same device must
+ * not get the same offset, or that device skips one of the two windows.
+ *
+ * Finding the offsets is an edge colouring of the graph with a node per
+ * device and an edge per link. The links are coloured greedily, in the order
+ * they were added, with the lowest offset that is free at both ends. This
+ * uses at most 2*D-1 offsets, with D the highest number of links of one
+ * device. The connection interval is then grown, if needed, so that all
+ * offsets fit in it.
+ */
+class BleAnchorAllocator
+{
+public:
+  /**
+   * Slots (of 1.25 ms) per transmit window, as laid out by SetupLink
+   */
+  static const uint32_t SLOTS_PER_WINDOW = 5;
+  /**
+   * Longest connection interval allowed by the specification (slots)
+   */
+  static const uint32_t MAX_CONN_INTERVAL = 3200;
+
+  BleAnchorAllocator ();
+
+  /**
+   * Add a link between two devices.
+   *
+   * \param deviceA index of the first device
+   * \param deviceB index of the second device
+   * \return the index of the link
+   */
+  uint32_t AddLink (uint32_t deviceA, uint32_t deviceB);
+
+  /**
+   * Assign an offset to every link that was added.
+   *
+   * \param nbConnInterval the requested connection interval (slots)
+   * \return false if the offsets do not fit in MAX_CONN_INTERVAL. The
+   *         offsets are assigned anyway, but windows will then overlap.
+   */
+  bool Allocate (uint32_t nbConnInterval);
+
+  /**
+   * \param link the index of a link
+   * \return the window offset of that link, in windows
+   */
+  uint32_t GetOffset (uint32_t link) const;
+
+  /**
+   * \return the connection interval (slots) all links should use: the
+   *         requested one, grown to hold every offset when possible
+   */
+  uint32_t GetConnInterval (void) const;
+
+  /**
+   * \return the number of distinct offsets in use
+   */
+  uint32_t GetNOffsets (void) const;
+
+private:
+  std::vector<std::pair<uint32_t, uint32_t> > m_links; //!< devices per link
+  std::vector<uint32_t> m_offsets; //!< offset per link, after Allocate
+  uint32_t m_nOffsets; //!< distinct offsets in use
+  uint32_t m_connInterval; //!< connection interval (slots)
+};
+
+} // namespace ns3
+
+#endif /* BLE_ANCHOR_ALLOCATOR_H */
@@ -57,6 +57,7 @@ namespace ns3 {
   BleBBManager::BleBBManager ()
   {
     NS_LOG_FUNCTION (this);
+    m_accessAddressStream = CreateObject<UniformRandomVariable> ();
   }
 
   BleBBManager::~BleBBManager ()
@@ -68,6 +69,12 @@ namespace ns3 {
     BleBBManager::DoDispose ()
     {
       NS_LOG_FUNCTION (this);
+      m_peerLinkManagers.clear ();
+      m_broadcastLinkManager = 0;
+      m_dispatchEvent.Cancel ();
+      m_pendingWindows.clear ();
+      m_windowQueue.clear ();
+      m_accessAddressStream = 0;
     }
 
   BleBBManager::BleBBManager (Ptr<BleNetDevice> bleNetDevice)
@@ -75,6 +82,7 @@ namespace ns3 {
     NS_LOG_FUNCTION (this);
 
     m_netDevice = bleNetDevice;
+    m_accessAddressStream = CreateObject<UniformRandomVariable> ();
   }
 
 /**********************
@@ -142,6 +150,92 @@ namespace ns3 {
   * END OF GETTERS AND SETTERS *
   ******************************/
 
+  void
+    BleBBManager::ScheduleTransmitWindow (Ptr<BleLinkManager> lm, Time delay)
+    {
+      NS_LOG_FUNCTION (this << lm << delay);
+      NS_ASSERT (lm);
+      NS_ASSERT (!delay.IsStrictlyNegative ());
+      CancelTransmitWindow (lm);
+      WindowQueue::iterator it = 
+        m_windowQueue.emplace (Simulator::Now () + delay, lm);
+      m_pendingWindows[PeekPointer (lm)] = it;
+      RescheduleDispatch ();
+    }
+
+  void
+    BleBBManager::CancelTransmitWindow (Ptr<BleLinkManager> lm)
+    {
+      NS_LOG_FUNCTION (this << lm);
+      auto pending = m_pendingWindows.find (PeekPointer (lm));
+      if (pending == m_pendingWindows.end ())
+      {
+        return;
+      }
+      m_windowQueue.erase (pending->second);
+      m_pendingWindows.erase (pending);
+      // A dispatch event that became too early is harmless, it re-arms itself
+      if (m_windowQueue.empty ())
+      {
+        m_dispatchEvent.Cancel ();
+      }
+    }
+
+  bool
+    BleBBManager::IsTransmitWindowScheduled (Ptr<BleLinkManager> lm) const
+    {
+      return m_pendingWindows.find (PeekPointer (lm)) != m_pendingWindows.end ();
+    }
+
+  Ptr<UniformRandomVariable>
+    BleBBManager::GetAccessAddressStream ()
+    {
+      return m_accessAddressStream;
+    }
+
+  int64_t
+    BleBBManager::AssignStreams (int64_t stream)
+    {
+      NS_LOG_FUNCTION (this << stream);
+      m_accessAddressStream->SetStream (stream);
+      return 1;
+    }
+
+  void
+    BleBBManager::RescheduleDispatch ()
+    {
+      if (m_windowQueue.empty ())
+      {
+        return;
+      }
+      Time next = m_windowQueue.begin ()->first;
+      if (!m_dispatchEvent.IsExpired () && m_dispatchTime <= next)
+      {
+        return;
+      }
+      m_dispatchEvent.Cancel ();
+      m_dispatchTime = next;
+      m_dispatchEvent = Simulator::Schedule (next - Simulator::Now (),
+          &BleBBManager::DispatchTransmitWindows, this);
+    }
+
+  void
+    BleBBManager::DispatchTransmitWindows ()
+    {
+      NS_LOG_FUNCTION (this);
+      Time now = Simulator::Now ();
+      // Every started window schedules the next one at least a connection 
+      // interval later, so this loop ends
+      while (!m_windowQueue.empty () && m_windowQueue.begin ()->first <= now)
+      {
+        Ptr<BleLinkManager> lm = m_windowQueue.begin ()->second;
+        m_pendingWindows.erase (PeekPointer (lm));
+        m_windowQueue.erase (m_windowQueue.begin ());
+        lm->StartTransmitWindow ();
+      }
+      RescheduleDispatch ();
+    }
+
   void
     BleBBManager::AddLinkManager(Ptr<BleLinkManager> linkManager)
     {
@@ -157,12 +251,49 @@ namespace ns3 {
       if (! LinkManagerExists(linkManager))
       {
         m_linkManagers.push_back(linkManager);
+        IndexLinkManager(linkManager);
       }
       else
       {
         NS_LOG_WARN ("LinkManager already exists in this baseband manager");
       }
     }
+
+  void
+    BleBBManager::IndexLinkManager(Ptr<BleLinkManager> linkManager)
+    {
+      Ptr<BleLink> link = linkManager->GetAssociatedLink();
+      NS_ASSERT(link);
+      if (link->GetLinkType() == BleLink::LinkType::BROADCAST)
+      {
+        if (!m_broadcastLinkManager)
+        {
+          m_broadcastLinkManager = linkManager;
+        }
+        return;
+      }
+      for (auto bbm : link->GetLinkedDevices())
+      {
+        NS_ASSERT(bbm);
+        if (bbm == this)
+        {
+          continue;
+        }
+        Ptr<BleNetDevice> nd = bbm->GetNetDevice ();
+        NS_ASSERT(nd);
+        // emplace keeps the link manager that was added first
+        m_peerLinkManagers.emplace (GetAddressKey (nd->GetAddress16()), 
+            linkManager);
+      }
+    }
+
+  uint16_t
+    BleBBManager::GetAddressKey (Mac16Address address)
+    {
+      uint8_t buffer[2];
+      address.CopyTo (buffer);
+      return (buffer[0] << 8) | buffer[1];
+    }
   
   Ptr<BleLink> 
     BleBBManager::CreateLinkScheduledMultipleNodes(
@@ -277,7 +408,7 @@ namespace ns3 {
       std::vector<uint8_t> chmap;
       for (int i=0; i< mapSize; i++)
       {
-        chmap.push_back(randT->GetInteger(1,37));
+        chmap.push_back(randT->GetInteger(0,36));
       }
       //std::vector<uint8_t> chmap = {1,4,7,9,11}; 
       uint8_t hopIncr = 2;
@@ -353,30 +484,7 @@ namespace ns3 {
     BleBBManager::LinkExists (Mac16Address address)
     {
       NS_LOG_FUNCTION (this);
-      std::list<Ptr<BleLinkManager>>::iterator it;
-      for (it = m_linkManagers.begin(); it != m_linkManagers.end(); ++it)
-      {
-        std::list<Ptr<BleBBManager>>::iterator it2;
-        Ptr<BleLinkManager> lm = *it;
-        Ptr<BleLink> temp = lm->GetAssociatedLink();
-        if (temp->GetLinkType() == BleLink::LinkType::BROADCAST 
-            && address == Mac16Address("FF:FF"))
-          return true;
-        std::list<Ptr<BleBBManager>> all_devices = temp->GetLinkedDevices();
-        for (it2 = all_devices.begin(); it2 != all_devices.end(); ++it2)
-        {
-          Ptr<BleBBManager> bbm = *it2;
-          NS_ASSERT(bbm);
-          Ptr<BleNetDevice> nd = bbm->GetNetDevice ();
-          NS_ASSERT(nd);
-          if (nd->GetAddress16() == address 
-              && temp->GetLinkType() != BleLink::LinkType::BROADCAST) 
-          {
-            return true;
-          }
-        }
-      }
-      return false;
+      return GetLinkManager (address) != 0;
     }
   
   
@@ -384,32 +492,18 @@ namespace ns3 {
     BleBBManager::GetLinkManager (Mac16Address address)
     {
       NS_LOG_FUNCTION (this);
-      std::list<Ptr<BleLinkManager>>::iterator it;
-      for (it = m_linkManagers.begin(); it != m_linkManagers.end(); ++it)
+      if (address == BleMacHeader::GetBroadcastAddress ())
       {
-        std::list<Ptr<BleBBManager>>::iterator it2;
-        Ptr<BleLinkManager> lm = *it;
-        Ptr<BleLink> temp = lm->GetAssociatedLink();
-        if (temp->GetLinkType() == BleLink::LinkType::BROADCAST 
-            && address == Mac16Address("FF:FF"))
-          return lm;
-        std::list<Ptr<BleBBManager>> all_devices = temp->GetLinkedDevices();
-        for (it2 = all_devices.begin(); it2 != all_devices.end(); ++it2)
-        {
-          Ptr<BleBBManager> bbm = *it2;
-          NS_ASSERT(bbm);
-          Ptr<BleNetDevice> nd = bbm->GetNetDevice ();
-          NS_ASSERT(nd);
-          if (nd->GetAddress16() == address 
-              && temp->GetLinkType() != BleLink::LinkType::BROADCAST) 
-          {
-            return lm;
-          }
-        }
+        return m_broadcastLinkManager;
+      }
+      std::unordered_map<uint16_t, Ptr<BleLinkManager>>::const_iterator it = 
+        m_peerLinkManagers.find (GetAddressKey (address));
+      if (it == m_peerLinkManagers.end ())
+      {
+        NS_LOG_LOGIC ("There is no link to a device with address " << address);
+        return 0;
       }
-      NS_LOG_WARN ("There is no link to a device with address " << address);
-      Ptr<BleLinkManager> lm = CreateObject<BleLinkManager> ();
-      return lm;
+      return it->second;
     }
   
 
@@ -417,32 +511,12 @@ namespace ns3 {
     BleBBManager::GetLink (Mac16Address address)
     {
       NS_LOG_FUNCTION (this);
-      std::list<Ptr<BleLinkManager>>::iterator it;
-      for (it = m_linkManagers.begin(); it != m_linkManagers.end(); ++it)
+      Ptr<BleLinkManager> lm = GetLinkManager (address);
+      if (!lm)
       {
-        std::list<Ptr<BleBBManager>>::iterator it2;
-        Ptr<BleLinkManager> lm = *it;
-        Ptr<BleLink> temp = lm->GetAssociatedLink();
-        if (temp->GetLinkType() == BleLink::LinkType::BROADCAST 
-            && address == Mac16Address("FF:FF"))
-          return temp;
-        std::list<Ptr<BleBBManager>> all_devices = temp->GetLinkedDevices();
-        for (it2 = all_devices.begin(); it2 != all_devices.end(); ++it2)
-        {
-          Ptr<BleBBManager> bbm = *it2;
-          NS_ASSERT(bbm);
-          Ptr<BleNetDevice> nd = bbm->GetNetDevice ();
-          NS_ASSERT(nd);
-          if (nd->GetAddress16() == address 
-              && temp->GetLinkType() != BleLink::LinkType::BROADCAST) 
-          {
-            return temp;
-          }
-        }
+        return 0;
       }
-      NS_LOG_WARN ("There is no link to a device with address " << address);
-      Ptr<BleLink> link = CreateObject<BleLink> ();
-      return link;
+      return lm->GetAssociatedLink();
     }
   
   
@@ -486,6 +560,7 @@ namespace ns3 {
            NS_LOG_INFO (" Link to destination of current packet exists ");
            Ptr<BleLinkManager> activeLinkManager = GetLinkManager (destAddr);
            activeLinkManager->GetQueue ()->Enqueue (item);
+           activeLinkManager->NotifyDataEnqueued ();
            
          }
        } // Queue was not empty
@@ -38,6 +38,9 @@
 
 #include <ns3/constants.h>
 
+#include <map>
+#include <unordered_map>
+
 namespace ns3 {
 
   // Classes
@@ -98,7 +101,7 @@ namespace ns3 {
 
       // Check if a link to a device with a specific address exists
       bool LinkExists (Mac16Address address);
-      // Get link to a specific address.
+      // Get link to a specific address, 0 if there is none.
       Ptr<BleLink> GetLink (Mac16Address address);
       Ptr<BleLinkManager> GetLinkManager (Mac16Address address);
 
@@ -120,13 +123,64 @@ namespace ns3 {
       void SetActiveLinkManager(Ptr<BleLinkManager> lm);
       Ptr<BleLinkManager> GetActiveLinkManager();
 
+      /*
+       * Connection event scheduler: the link managers of this device do not
+       * schedule their own transmit windows. The BB manager keeps their next
+       * anchor points ordered by time and only has the earliest one in the
+       * simulator event queue. A link manager has at most one pending window,
+       * scheduling it again replaces the previous one.
+       */
+      void ScheduleTransmitWindow(Ptr<BleLinkManager> lm, Time delay);
+      void CancelTransmitWindow(Ptr<BleLinkManager> lm);
+      bool IsTransmitWindowScheduled(Ptr<BleLinkManager> lm) const;
+
+      /*
+       * Stream the access addresses of the links this device sets up are 
+       * drawn from
+       */
+      Ptr<UniformRandomVariable> GetAccessAddressStream ();
+
+      /*
+       * Assign a fixed stream to the random variables of the BB manager.
+       * Returns the number of streams assigned.
+       */
+      int64_t AssignStreams (int64_t stream);
+
     private:
+      // Start the transmit windows that are due and wait for the next one
+      void DispatchTransmitWindows ();
+      // Make sure the simulator event is set for the earliest anchor point
+      void RescheduleDispatch ();
+
+      // Add the peers of a link manager to the address index, unless an
+      // earlier link manager already serves them
+      void IndexLinkManager (Ptr<BleLinkManager> linkManager);
+      static uint16_t GetAddressKey (Mac16Address address);
+
       Ptr<BleNetDevice> m_netDevice;
       std::list<Ptr<BleLinkManager>> m_linkManagers; 
 
+      // Link manager per peer address (as 16 bit key), for point to point 
+      // links, and the link manager of the first broadcast link
+      std::unordered_map<uint16_t, Ptr<BleLinkManager>> m_peerLinkManagers;
+      Ptr<BleLinkManager> m_broadcastLinkManager;
+
       // The LinkManager that has control over the device
       // at this moment
       Ptr<BleLinkManager> m_activeLinkManager;
+
+      // Pending transmit windows of all link managers, by start time. Windows
+      // with the same start time are started in the order they were scheduled
+      typedef std::multimap<Time, Ptr<BleLinkManager>> WindowQueue;
+      WindowQueue m_windowQueue;
+      std::unordered_map<const BleLinkManager *, WindowQueue::iterator> 
+        m_pendingWindows;
+      // The only simulator event of the scheduler, and its time
+      EventId m_dispatchEvent;
+      Time m_dispatchTime;
+
+      // Draws the access addresses of the links this device sets up
+      Ptr<UniformRandomVariable> m_accessAddressStream;
  };
 
 }
@@ -22,10 +22,39 @@
 
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <algorithm>
+#include <random>
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE("BleErrorModel");
+
+namespace {
+
+/**
+ * Uniform random bit generator drawing from an ns-3 stream, so standard
+ * library distributions stay reproducible and obey stream assignment.
+ */
+struct UniformStreamEngine
+{
+  typedef uint32_t result_type;
+  static constexpr result_type min () { return 0; }
+  static constexpr result_type max () { return 0xFFFFFFFF; }
+
+  explicit UniformStreamEngine (Ptr<UniformRandomVariable> random)
+    : m_random (random)
+  {
+  }
+
+  result_type operator() ()
+  {
+    return m_random->GetInteger (0, 0xFFFFFFFF);
+  }
+
+  Ptr<UniformRandomVariable> m_random; //!< the ns-3 stream
+};
+
+} // anonymous namespace
 NS_OBJECT_ENSURE_REGISTERED (BleErrorModel);
 
 TypeId
@@ -57,4 +86,113 @@ BleErrorModel::GetBER (double snr) const
 	}
 }
 
+const double BleErrorModel::TABLE_MIN_DB = -30.0;
+const double BleErrorModel::TABLE_STEP_DB = 0.05;
+
+const std::vector<double> &
+BleErrorModel::GetBerTable (void)
+{
+  static std::vector<double> table;
+  if (table.empty ())
+    {
+      table.resize (TABLE_SIZE);
+      for (std::size_t i = 0; i < TABLE_SIZE; i++)
+        {
+          double snrDb = TABLE_MIN_DB + i * TABLE_STEP_DB;
+          // same curve as GetBER (snr)
+          table[i] = erfcl (sqrtl (std::pow (10.0, snrDb / 10))) / 2;
+        }
+    }
+  return table;
+}
+
+double
+BleErrorModel::GetCodingGain (uint8_t coding)
+{
+  NS_ASSERT (coding == 1 || coding == 2 || coding == 8);
+  return coding == 8 ? 8.0 : (coding == 2 ? 4.0 : 0.0);
+}
+
+double
+BleErrorModel::Interpolate (const std::vector<double> &table, double snrDb)
+{
+  // Clamp instead of branching, so batch loops can be vectorised.
+  double x = (snrDb - TABLE_MIN_DB) / TABLE_STEP_DB;
+  x = std::min (std::max (x, 0.0), (double) (TABLE_SIZE - 1));
+  std::size_t i = std::min ((std::size_t) x, TABLE_SIZE - 2);
+  double f = x - i;
+  return table[i] + f * (table[i + 1] - table[i]);
+}
+
+double
+BleErrorModel::GetBER (double snr, uint8_t coding) const
+{
+  if (snr <= 0)
+    {
+      return 0;
+    }
+  return Interpolate (GetBerTable (), 10 * std::log10 (snr) 
+                                      + GetCodingGain (coding));
+}
+
+void
+BleErrorModel::GetBER (const double *snrDb, double *ber, std::size_t n,
+                       uint8_t coding) const
+{
+  const std::vector<double> &table = GetBerTable ();
+  double gain = GetCodingGain (coding);
+  for (std::size_t i = 0; i < n; i++)
+    {
+      ber[i] = Interpolate (table, snrDb[i] + gain);
+    }
+}
+
+uint32_t
+BleErrorModel::GetBitErrors (double ber, uint32_t bits,
+                             Ptr<UniformRandomVariable> random) const
+{
+  if (bits == 0 || ber <= 0)
+    {
+      return 0;
+    }
+  if (ber >= 1)
+    {
+      return bits;
+    }
+
+  // Sample the rarer outcome, so the geometric walk below stays short.
+  bool complement = ber > 0.5;
+  double p = complement ? 1 - ber : ber;
+  double variance = bits * p * (1 - p);
+  uint32_t count = 0;
+
+  if (variance >= 30)
+    {
+      // Many errors expected: let the standard library draw the binomial
+      // count exactly, from the same ns-3 stream.
+      UniformStreamEngine engine (random);
+      std::binomial_distribution<uint32_t> binomial (bits, p);
+      count = binomial (engine);
+    }
+  else
+    {
+      // Walk from error to error: the number of correct bits before the
+      // next error is geometrically distributed with parameter p.
+      double logq = std::log1p (-p);
+      double position = 0;
+      while (true)
+        {
+          double u = random->GetValue ();
+          position += std::floor (std::log (1 - u) / logq) + 1;
+          if (position > bits)
+            {
+              break;
+            }
+          count++;
+        }
+    }
+
+  return complement ? bits - count : count;
+}
+
 } // namespace ns3
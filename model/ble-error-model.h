@@ -22,6 +22,10 @@
 
 
 #include <ns3/object.h>
+#include <ns3/ptr.h>
+#include <ns3/random-variable-stream.h>
+
+#include <vector>
 
 namespace ns3 {
 
@@ -45,15 +49,77 @@ public:
   BleErrorModel (void);
 
   /**
-   * Return BER for given SNR.
+   * Return BER for given SNR, computed exactly on the uncoded GFSK curve.
+   * This is the reference the tables are built from.
    *
    * \return bit error rate
    * \param snr SNR expressed as a power ratio (i.e. not in dB)
    */
   long double GetBER (double snr) const;
 
+  /**
+   * Return BER for given SNR, after FEC decoding on the LE Coded PHY,
+   * interpolated from the BER table.
+   * The convolutional code and, for S=8, the pattern mapping are modelled
+   * as a coding gain on the uncoded GFSK curve: 4 dB for S=2, 8 dB for S=8.
+   *
+   * \return bit error rate of the decoded bits
+   * \param snr SNR expressed as a power ratio (i.e. not in dB)
+   * \param coding the coding factor S: 1 (uncoded), 2 or 8
+   */
+  double GetBER (double snr, uint8_t coding) const;
+
+  /**
+   * Interpolate the BER of a contiguous array of SNRs in one loop.
+   *
+   * \param snrDb the SNRs (dB)
+   * \param ber where to store the n bit error rates
+   * \param n number of SNRs
+   * \param coding the coding factor S: 1 (uncoded), 2 or 8
+   */
+  void GetBER (const double *snrDb, double *ber, std::size_t n,
+               uint8_t coding) const;
+
+  /**
+   * Draw the number of bit errors in a run of bits that all see the same
+   * bit error rate. The count follows the binomial distribution B(bits, ber)
+   * but costs O(1) expected random draws instead of one draw per bit:
+   * the gaps between errors are drawn from the geometric distribution, and
+   * when many errors are expected std::binomial_distribution draws the
+   * count, fed from the same stream. Both draws are exact.
+   *
+   * \param ber bit error rate of every bit in the run
+   * \param bits number of bits in the run
+   * \param random uniform [0,1) stream used for all draws
+   * \return the number of erroneous bits, at most bits
+   */
+  uint32_t GetBitErrors (double ber, uint32_t bits,
+                         Ptr<UniformRandomVariable> random) const;
+
 private:
+  static const double TABLE_MIN_DB; //!< SNR (dB) of the first table entry
+  static const double TABLE_STEP_DB; //!< SNR (dB) between table entries
+  static const std::size_t TABLE_SIZE = 1201; //!< entries per table
+
+  /**
+   * \return the uncoded BER table, built on first use
+   */
+  static const std::vector<double> &GetBerTable (void);
 
+  /**
+   * \param coding the coding factor S: 1 (uncoded), 2 or 8
+   * \return the coding gain (dB)
+   */
+  static double GetCodingGain (uint8_t coding);
+
+  /**
+   * Linear interpolation in a table, clamped to its first and last entry.
+   *
+   * \param table the table, TABLE_SIZE entries
+   * \param snrDb the SNR (dB)
+   * \return the interpolated value
+   */
+  static double Interpolate (const std::vector<double> &table, double snrDb);
 };
 
 
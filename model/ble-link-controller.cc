@@ -152,7 +152,7 @@ namespace ns3 {
 
   void
     BleLinkController::SetCheckedAckCallback (Callback<void, 
-        Ptr<Packet> > callback)
+        Ptr<Packet>, const BleMacHeader &> callback)
     {
       NS_LOG_FUNCTION (this);
       m_ackChecked = callback;
@@ -167,28 +167,6 @@ namespace ns3 {
     }
 
 
-  void 
-    BleLinkController::SetAllChannels (
-        std::vector<Ptr<SpectrumChannel>> allChannels)
-    {
-      NS_LOG_FUNCTION (this);
-      m_allChannels = allChannels;
-    }
-
-  Ptr<SpectrumChannel>
-    BleLinkController::GetChannelBasedOnChannelIndex (uint8_t channelIndex)
-    {
-      if (m_allChannels.size() == 0)
-      {
-        return 0;
-      }
-      NS_ASSERT (channelIndex < m_allChannels.size());
-      return m_allChannels.at(channelIndex); 
-
-    }
-
-
-
   /******************************
    * END OF GETTERS AND SETTERS *
    ******************************/
@@ -210,7 +188,9 @@ namespace ns3 {
       NS_LOG_FUNCTION(this);
       NS_ASSERT(this->GetCurrentPacket());
 
-      if (StartTransmission (this->GetCurrentPacket()->Copy(), false))
+      // The packet is shared with the PHY and the channel, which never 
+      // modify it, and is reused as is for a retransmission
+      if (StartTransmission (this->GetCurrentPacket(), false))
       {
         retransmissionCount++;
         m_macTxTrace (this->GetCurrentPacket());
@@ -224,7 +204,8 @@ namespace ns3 {
     }
 
   bool
-    BleLinkController::StartTransmission (Ptr<Packet> packet, bool ackPacket)
+    BleLinkController::StartTransmission (Ptr<const Packet> packet, 
+        bool ackPacket)
     {
       NS_LOG_FUNCTION (this);
       // Set parameters of phy device
@@ -264,7 +245,8 @@ namespace ns3 {
       NS_LOG_FUNCTION(this);
       NS_ASSERT(lm->GetCurrentPacket());
       
-      if (StartTransmission (lm->GetCurrentPacket()->Copy(), false)) 
+      // Shared, not copied: see StartTransmissionNoArgs
+      if (StartTransmission (lm->GetCurrentPacket(), false)) 
       {
         m_macTxTrace (lm->GetCurrentPacket());
       }
@@ -290,7 +272,7 @@ namespace ns3 {
         packet->PeekHeader(bmh); 
         
         // Ignore broadcast for error callback
-        if (bmh.GetDestAddr() != Mac16Address("FF:FF") 
+        if (bmh.GetDestAddr() != BleMacHeader::GetBroadcastAddress () 
             || this->GetBBManager()->GetActiveLinkManager()->GetState() 
             == BleLinkManager::State::SCANNER)
         {
@@ -314,13 +296,13 @@ namespace ns3 {
             " SN = " << bmh.GetSN() << " NESN = " <<
             bmh.GetNESN() ); //<< " length = " << int(bmh.GetLength()));
         if (bmh.GetDestAddr() == this->GetNetDevice()->GetAddress16() ||
-            bmh.GetDestAddr() == Mac16Address("FF:FF") )
+            bmh.GetDestAddr() == BleMacHeader::GetBroadcastAddress () )
         {
           if (lm->GetState() == BleLinkManager::State::SCANNER )
           {
             NS_LOG_INFO ("Received an ADVERTISING packet, length = " 
                 << int(bmh.GetLength()));
-            m_ackChecked (packet);
+            m_ackChecked (packet, bmh);
           }
           else
           {
@@ -343,7 +325,7 @@ namespace ns3 {
                 //NS_ASSERT (bmh.GetLength() > 0);
                 NS_LOG_INFO ("Received a data packet, length = " 
                     << int(bmh.GetLength()));
-                m_ackChecked (packet);
+                m_ackChecked (packet, bmh);
               }
             }
             else
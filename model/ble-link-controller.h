@@ -34,6 +34,7 @@
 
 #include <ns3/constants.h>
 #include <ns3/spectrum-channel.h>
+#include <ns3/ble-mac-header.h>
 
 namespace ns3 {
 
@@ -86,12 +87,13 @@ namespace ns3 {
       void CheckReceivedAckPacket (Ptr<Packet> packet, bool receptionError);
 
 
-      void SetCheckedAckCallback (Callback<void, Ptr<Packet> > callback);
+      /**
+       * Set the callback for received data, which gets the header parsed 
+       * by CheckReceivedAckPacket along with the packet.
+       */
+      void SetCheckedAckCallback (
+          Callback<void, Ptr<Packet>, const BleMacHeader &> callback);
       void SetCheckedAckErrorCallback (Callback<void, Ptr<Packet> > callback);
-
-      void SetAllChannels (std::vector<Ptr<SpectrumChannel>> allChannels);
-
-      Ptr<SpectrumChannel> GetChannelBasedOnChannelIndex(uint8_t channelIndex);
     private:
       Ptr<BleNetDevice> m_netDevice; // Associated netdevice
 
@@ -101,7 +103,7 @@ namespace ns3 {
       Time startTimePacket; //!< time that device tried to send a 
                             //   packet for the first time
       Time lastSend; //!< time at which was last transmission 
-      Callback<void, Ptr<Packet> > m_ackChecked;
+      Callback<void, Ptr<Packet>, const BleMacHeader &> m_ackChecked;
       Callback<void, Ptr<Packet> > m_ackCheckedError;
       // Traceback functions:
       TracedCallback<Ptr<const Packet> > m_macTxTrace;
@@ -111,9 +113,7 @@ namespace ns3 {
 
       // Functions:
       
-      bool StartTransmission (Ptr<Packet> packet, bool ackPacket);
-      
-      std::vector<Ptr<SpectrumChannel>> m_allChannels;
+      bool StartTransmission (Ptr<const Packet> packet, bool ackPacket);
   };
 
 }
@@ -30,6 +30,11 @@
 #include <ns3/drop-tail-queue.h>
 #include <ns3/queue-item.h>
 #include <ns3/multi-model-spectrum-channel.h>
+#include <ns3/uinteger.h>
+#include <ns3/boolean.h>
+#include <ns3/enum.h>
+#include <ns3/fatal-error.h>
+#include <algorithm>
 
 namespace ns3 {
 
@@ -43,6 +48,28 @@ namespace ns3 {
       static TypeId tid = TypeId ("ns3::BleLinkManager")
         .SetParent<Object> ()
         .AddConstructor<BleLinkManager> ()
+        .AddAttribute ("ConnSlaveLatency",
+            "Number of connection events a slave with nothing to send "
+            "may sleep through.",
+            UintegerValue (0),
+            MakeUintegerAccessor (&BleLinkManager::SetConnSlaveLatency,
+                                  &BleLinkManager::GetConnSlaveLatency),
+            MakeUintegerChecker<uint16_t> (0, 499))
+        .AddAttribute ("IdleFastForward",
+            "Skip the connection events in which master and slave only "
+            "exchange empty packets, and account their airtime "
+            "analytically. The skipped packets cause no interference.",
+            BooleanValue (false),
+            MakeBooleanAccessor (&BleLinkManager::m_idleFastForward),
+            MakeBooleanChecker ())
+        .AddAttribute ("ChannelSelection",
+            "Channel selection algorithm of connected links. The master's "
+            "choice is used for both ends of a link.",
+            EnumValue (BleLinkManager::CSA_1),
+            MakeEnumAccessor<BleLinkManager::ChannelSelection> (
+              &BleLinkManager::m_channelSelection),
+            MakeEnumChecker (BleLinkManager::CSA_1, "CSA_1",
+                             BleLinkManager::CSA_2, "CSA_2"))
         // Add attributes and tracesources
         ;
       return tid;
@@ -59,6 +86,16 @@ namespace ns3 {
     m_peerHasMoreData = false;
     m_onePacketSend = false;
     m_lastUnmappedChannelIndex = 0;
+    m_latencySkips = 0;
+    m_idleFastForward = false;
+    m_fastForwarding = false;
+    m_windowHadData = false;
+    m_windowSn = false;
+    m_windowNesn = false;
+    m_ffEvents = 0;
+    m_channelSelection = CSA_1;
+    m_hopTableBase = 0;
+    m_hopTableValid = false;
 
     m_broadcastCollisionAvoidance = true;
     m_advSleepCounter = 0;
@@ -84,6 +121,7 @@ namespace ns3 {
     BleLinkManager::DoDispose () {
       NS_LOG_FUNCTION (this);
       m_queue = 0;
+      m_peerLinkManager = 0;
     }
 
   BleLinkManager::~BleLinkManager ()
@@ -219,6 +257,8 @@ namespace ns3 {
       this->expectedRole = myRole;
      
       Ptr<BleLink> link = CreateObject<BleLink> ();
+      link->GenerateAccessAddress (
+          this->GetBBManager()->GetAccessAddressStream());
       this->SetAssociatedLink(link);
       otherLinkManager->SetAssociatedLink(link);
       this->m_nextExpectedSequenceNumber = false;
@@ -227,6 +267,17 @@ namespace ns3 {
       otherLinkManager->m_sequenceNumber = false;
       this->m_lastUnmappedChannelIndex = 0;
       otherLinkManager->m_lastUnmappedChannelIndex = 0;
+      this->m_connEventCounter = 0;
+      otherLinkManager->m_connEventCounter = 0;
+      // Both ends must hop alike, the master decides
+      if (this->expectedRole == MASTER_ROLE)
+      {
+        otherLinkManager->m_channelSelection = m_channelSelection;
+      }
+      else
+      {
+        m_channelSelection = otherLinkManager->m_channelSelection;
+      }
       // If SLAVE: start advertising in order to find master
       //
       // to start: assume that links are created instantly 
@@ -252,9 +303,12 @@ namespace ns3 {
         link->SetMaster(this->GetBBManager());
         link->SetLinkType(BleLink::LinkType::UNCONNECTED);
       }
-      link->SetChannel (
-          this->GetBBManager()->GetLinkController()
-          ->GetChannelBasedOnChannelIndex (0));
+      // The two ends of a connection fast forward together
+      if (link->GetLinkType() == BleLink::LinkType::POINT_TO_POINT)
+      {
+        this->m_peerLinkManager = otherLinkManager;
+        otherLinkManager->m_peerLinkManager = this;
+      }
      
       int connInterval = nbConnectionInterval; //3200
       int txWindowSize = 5000; //4*1250; // in Microseconds
@@ -337,13 +391,11 @@ namespace ns3 {
       Ptr<BleLink> link = CreateObject<BleLink> ();
       link->SetMaster(this->GetBBManager());
       link->SetLinkType(BleLink::LinkType::BROADCAST);
-      link->SetChannel (
-          this->GetBBManager()->GetLinkController()
-          ->GetChannelBasedOnChannelIndex (0));
       this->SetAssociatedLink(link);
       this->m_nextExpectedSequenceNumber = false;
       this->m_sequenceNumber = false;
       this->m_lastUnmappedChannelIndex = 0;
+      this->m_connEventCounter = 0;
       uint16_t counter = 1;
       uint16_t max_counter = otherLinkManagers.size() + 1; 
  
@@ -357,6 +409,7 @@ namespace ns3 {
         lm->m_nextExpectedSequenceNumber = false;
         lm->m_sequenceNumber = false;
         lm->m_lastUnmappedChannelIndex = 0;
+        lm->m_connEventCounter = 0;
         link->AddSlave(lm->GetBBManager());
         lm->expectedRole = BleLinkManager::Role::CONNECTIONLESS_ROLE;
         lm->SetState(BleLinkManager::State::SCANNER);
@@ -428,6 +481,7 @@ namespace ns3 {
     {
       NS_LOG_FUNCTION (this);
       m_associatedLink = link;
+      m_hopTableValid = false;
     }
 
   void
@@ -722,10 +776,8 @@ namespace ns3 {
      BleLinkManager::PrepareNextTransmitWindow ()
      {
        NS_LOG_FUNCTION (this);
-       m_nextWindow = Simulator::Schedule(
-           GetNextTransmitWindowTime(),
-           &BleLinkManager::StartTransmitWindow,
-           this);
+       this->GetBBManager()->ScheduleTransmitWindow(this,
+           GetNextTransmitWindowTime());
      }
 
   bool 
@@ -762,6 +814,43 @@ namespace ns3 {
        }
      }
 
+   bool
+     BleLinkManager::FitsInLastTransmitWindow (Time thisTime, 
+         bool readyForNewData)
+     {
+       NS_LOG_FUNCTION (this << thisTime << readyForNewData);
+       uint32_t emptySize = BleMacHeader ().GetSerializedSize ();
+       uint32_t size = emptySize;
+       if (this->GetCurrentPacket () && (! readyForNewData) 
+           && (! (this->GetState() == ADVERTISER)))
+       {
+         size = this->GetCurrentPacket ()->GetSize ();
+       }
+       else if (m_queue && (! m_queue->IsEmpty ()))
+       {
+         // Queued packets already carry their BleMacHeader
+         size = m_queue->Peek ()->GetPacket ()->GetSize ();
+       }
+
+       Ptr<BlePhy> phy = this->GetBBManager()->GetPhy();
+       Time exchange = phy->GetAirtime (size);
+       if (this->GetState() != ADVERTISER)
+       {
+         // Advertising will not get a response
+         exchange += MicroSeconds (T_IFS) + phy->GetAirtime (emptySize);
+       }
+
+       if (exchange > GetTransmitWindowSize ())
+       {
+         NS_LOG_WARN ("Exchange of " << exchange.GetMicroSeconds () 
+             << " us does not fit in a transmit window of " 
+             << GetTransmitWindowSize ().GetMicroSeconds () << " us");
+         return ! m_onePacketSend;
+       }
+       return thisTime + exchange 
+         <= GetLastTransmitWindowTime () + GetTransmitWindowSize ();
+     }
+
    void
      BleLinkManager::SendNextPacket()
      {
@@ -775,7 +864,8 @@ namespace ns3 {
        else
          readyForNewData = ManageSequenceNumberTX();
        
-       if (IsInsideLastTransmitWindow (currentTime))
+       if (IsInsideLastTransmitWindow (currentTime)
+           && FitsInLastTransmitWindow (currentTime, readyForNewData))
        {
            if (this->GetCurrentPacket () && (! readyForNewData) 
                && (! (this->GetState() == ADVERTISER)))
@@ -802,7 +892,7 @@ namespace ns3 {
                if (this->GetState() == ADVERTISER)
                {
                  // If advertising, dest address needs to be broadcast address
-                 NS_ASSERT (bmh1.GetDestAddr() == Mac16Address("ff:ff"));
+                 NS_ASSERT (bmh1.GetDestAddr() == BleMacHeader::GetBroadcastAddress ());
                }
                
                bmh1.SetLLID(0b10);
@@ -811,11 +901,11 @@ namespace ns3 {
                // More data to send
                bmh1.SetMD(! m_queue->IsEmpty ());
                this->SetMyLastMD(! m_queue->IsEmpty ());
-               //bmh1.SetLength(item->GetPacket ()->GetSize());
-               bmh1.SetLength(1);
+               bmh1.SetLength(BleMacHeader::GetLengthField (packet->GetSize()));
                packet->AddHeader(bmh1);
                this->SetCurrentPacket (packet);
                m_onePacketSend =true;
+               m_windowHadData = true;
              }
              else
              {
@@ -843,7 +933,7 @@ namespace ns3 {
                  bmh2.SetSN(m_sequenceNumber);
                  bmh2.SetSrcAddr(
                      this->GetBBManager()->GetNetDevice()->GetAddress16());
-                 bmh2.SetDestAddr(Mac16Address("FF:FF"));
+                 bmh2.SetDestAddr(BleMacHeader::GetBroadcastAddress ());
                  dummyPacket->AddHeader(bmh2);
                  SetCurrentPacket (dummyPacket);
                  m_onePacketSend = true;
@@ -916,6 +1006,10 @@ namespace ns3 {
        // wait for packet from master to arrive
 
        NS_LOG_FUNCTION (this);
+       // Keep the hop sequence and event counter in step with the master
+       // for the events that were slept through
+       SkipConnectionEvents (m_latencySkips);
+       m_latencySkips = 0;
        if (!this->GetBBManager()->GetActiveLinkManager())
        {
          this->GetBBManager()->SetActiveLinkManager(this);
@@ -933,10 +1027,15 @@ namespace ns3 {
 
          m_firstTransmitWindowDone = true;
          m_onePacketSend = false;
+         m_windowHadData = false;
+         m_windowSn = m_sequenceNumber;
+         m_windowNesn = m_nextExpectedSequenceNumber;
          SetMyLastMD(true);
 
          PrepareNextTransmitWindow ();
          ManageChannelSelection();
+         this->GetBBManager()->GetPhy()->SetAccessAddress (
+             this->GetAssociatedLink()->GetAccessAddress());
          if (expectedRole == MASTER_ROLE)
          {
            SendNextPacket();
@@ -1062,51 +1161,328 @@ namespace ns3 {
          }
        }
 
+       if (this->GetBBManager()->GetActiveLinkManager() != this)
+       {
+         ApplySlaveLatency ();
+         if (m_idleFastForward && expectedRole == MASTER_ROLE 
+             && IsIdleEvent ())
+         {
+           StartFastForward ();
+         }
+       }
      }
 
    bool
-     BleLinkManager::IsUsedChannel (uint8_t channelIndex)
+     BleLinkManager::IsIdleEvent ()
+     {
+       Ptr<BleLinkManager> peer = m_peerLinkManager;
+       if (!peer || m_fastForwarding || m_latencySkips > 0 
+           || peer->m_latencySkips > 0)
+       {
+         return false;
+       }
+       // Both ends took part in this event and are done with it
+       if (peer->GetLastTransmitWindowTime () != GetLastTransmitWindowTime ()
+           || peer->GetBBManager()->GetActiveLinkManager() == peer)
+       {
+         return false;
+       }
+       // Only empty packets were exchanged, and nothing is waiting
+       if (m_windowHadData || peer->m_windowHadData 
+           || !m_queue->IsEmpty () || !peer->m_queue->IsEmpty ()
+           || GetPeerHasMoreData () || peer->GetPeerHasMoreData ())
+       {
+         return false;
+       }
+       // The sequence numbers came back to where they were: the next idle
+       // events would leave them there too
+       return m_sequenceNumber == m_windowSn 
+         && m_nextExpectedSequenceNumber == m_windowNesn
+         && peer->m_sequenceNumber == peer->m_windowSn
+         && peer->m_nextExpectedSequenceNumber == peer->m_windowNesn;
+     }
+
+   void
+     BleLinkManager::StartFastForward ()
+     {
+       NS_LOG_FUNCTION (this);
+       NS_LOG_INFO (this << " Link " << GetAssociatedLink() 
+           << " is idle, fast forwarding its connection events");
+       Ptr<BleLinkManager> ends[2] = {this, m_peerLinkManager};
+       for (Ptr<BleLinkManager> lm : ends)
+       {
+         lm->m_fastForwarding = true;
+         lm->m_ffAnchor = GetLastTransmitWindowTime ();
+         lm->GetBBManager()->CancelTransmitWindow (lm);
+       }
+     }
+
+   void
+     BleLinkManager::StopFastForward ()
+     {
+       NS_LOG_FUNCTION (this);
+       NS_ASSERT (m_peerLinkManager);
+       // First anchor point that is still to come
+       int64_t elapsed = (Simulator::Now () - m_ffAnchor).GetTimeStep ();
+       uint64_t events = elapsed / GetConnInterval ().GetTimeStep () + 1;
+       Time next = m_ffAnchor + GetConnInterval () * int64_t (events);
+       NS_LOG_INFO (this << " Data to send, resuming link " 
+           << GetAssociatedLink() << " after " << events - 1 
+           << " idle connection events");
+       Ptr<BleLinkManager> ends[2] = {this, m_peerLinkManager};
+       for (Ptr<BleLinkManager> lm : ends)
+       {
+         lm->m_ffEvents += events - 1;
+         lm->m_fastForwarding = false;
+         lm->m_latencySkips = events - 1;
+         lm->GetBBManager()->ScheduleTransmitWindow (lm, 
+             next - Simulator::Now ());
+       }
+     }
+
+   uint64_t
+     BleLinkManager::GetFastForwardedEvents ()
+     {
+       uint64_t events = m_ffEvents;
+       if (m_fastForwarding)
+       {
+         // Events of the current idle period that are already over
+         int64_t elapsed = (Simulator::Now () - m_ffAnchor).GetTimeStep ();
+         events += elapsed / GetConnInterval ().GetTimeStep ();
+       }
+       return events;
+     }
+
+   Time
+     BleLinkManager::GetFastForwardedAirtime ()
+     {
+       // In every idle event this device sends one empty packet and 
+       // receives one
+       Time emptyPdu = GetBBManager()->GetPhy()->GetAirtime (
+           BleMacHeader ().GetSerializedSize ());
+       return emptyPdu * int64_t (2 * GetFastForwardedEvents ());
+     }
+
+   bool
+     BleLinkManager::CanSkipConnectionEvents ()
+     {
+       if (expectedRole != SLAVE_ROLE || GetConnSlaveLatency () == 0
+           || !m_queue->IsEmpty () || GetPeerHasMoreData ())
+       {
+         return false;
+       }
+       // A data packet that was not acknowledged yet is retransmitted 
+       // in the next event
+       if (GetCurrentPacket () && m_sequenceNumber == m_nextExpectedSequenceNumber)
+       {
+         BleMacHeader bmh;
+         GetCurrentPacket ()->PeekHeader (bmh);
+         return bmh.GetLLID () != 0b10;
+       }
+       return true;
+     }
+
+   void
+     BleLinkManager::ApplySlaveLatency ()
      {
-       for (auto v : this->m_usedChannels) 
+       NS_LOG_FUNCTION (this);
+       if (m_fastForwarding || !CanSkipConnectionEvents ())
+       {
+         return;
+       }
+       m_latencySkips = GetConnSlaveLatency ();
+       Time next = GetLastTransmitWindowTime () 
+         + GetConnInterval () * int64_t (m_latencySkips + 1);
+       NS_LOG_INFO (this << " Nothing to send, sleeping through " 
+           << m_latencySkips << " connection events");
+       this->GetBBManager()->ScheduleTransmitWindow(this,
+           next - Simulator::Now ());
+     }
+
+   void
+     BleLinkManager::NotifyDataEnqueued ()
+     {
+       NS_LOG_FUNCTION (this);
+       if (m_fastForwarding)
+       {
+         StopFastForward ();
+         return;
+       }
+       if (m_latencySkips == 0)
+       {
+         return;
+       }
+       // Wake up at the first anchor point that is still to come
+       int64_t elapsed = (Simulator::Now () - GetLastTransmitWindowTime ())
+         .GetTimeStep ();
+       uint64_t events = elapsed / GetConnInterval ().GetTimeStep () + 1;
+       if (events > m_latencySkips)
        {
-         if (v == channelIndex)
-           return true;
+         return;
        }
-       return false;
+       m_latencySkips = events - 1;
+       NS_LOG_INFO (this << " Data to send, waking up after " 
+           << m_latencySkips << " skipped connection events");
+       this->GetBBManager()->ScheduleTransmitWindow(this,
+           GetLastTransmitWindowTime () + GetConnInterval () * int64_t (events)
+           - Simulator::Now ());
+     }
+
+   void
+     BleLinkManager::SkipConnectionEvents (uint64_t events)
+     {
+       m_lastUnmappedChannelIndex = 
+         (m_lastUnmappedChannelIndex + (events % 37) * m_hopIncrement) % 37;
+       m_connEventCounter += events;
+     }
+
+   bool
+     BleLinkManager::IsUsedChannel (uint8_t channelIndex)
+     {
+       return std::binary_search (m_usedChannels.begin (), 
+           m_usedChannels.end (), channelIndex);
      }
  
    void
      BleLinkManager::SetUsedChannels (std::vector<uint8_t> usedChannels)
      {
        NS_LOG_FUNCTION (this);
+       // Both channel selection algorithms remap to the used channels in 
+       // ascending order, and a channel listed twice would be picked more often
+       std::sort (usedChannels.begin (), usedChannels.end ());
+       usedChannels.erase (
+           std::unique (usedChannels.begin (), usedChannels.end ()),
+           usedChannels.end ());
+       NS_ASSERT (usedChannels.size() != 0);
+       if (usedChannels.back () >= 40)
+       {
+         NS_FATAL_ERROR ("No RF channel " << (uint32_t) usedChannels.back ());
+       }
+       if (usedChannels.front () < 37 && usedChannels.back () >= 37)
+       {
+         NS_FATAL_ERROR ("A channel map holds data channels (0 to 36) or "
+             "advertising channels (37 to 39), not both");
+       }
        m_usedChannels = usedChannels;
+       m_hopTableValid = false;
+     }
+
+
+   uint16_t
+     BleLinkManager::GetCsa2Prn (uint16_t counter, uint16_t channelIdentifier)
+     {
+       uint16_t prn = counter ^ channelIdentifier;
+       for (int round = 0; round < 3; round++)
+       {
+         // PERM: reverse the bits of each byte
+         uint16_t perm = 0;
+         for (int bit = 0; bit < 8; bit++)
+         {
+           perm |= ((prn >> bit) & 0x0101) << (7 - bit);
+         }
+         prn = perm;
+         // MAM
+         prn = 17 * prn + channelIdentifier;
+       }
+       return prn ^ channelIdentifier;
      }
 
+   uint8_t
+     BleLinkManager::MapCsa2Channel (uint16_t prn, const bool isUsed[37],
+         const std::vector<uint8_t> &sortedUsed)
+     {
+       uint8_t unmapped = prn % 37;
+       if (isUsed[unmapped])
+       {
+         return unmapped;
+       }
+       return sortedUsed[(sortedUsed.size () * prn) >> 16];
+     }
+
+   uint8_t
+     BleLinkManager::GetCsa2Channel (uint16_t counter, 
+         uint16_t channelIdentifier, std::vector<uint8_t> usedChannels)
+     {
+       NS_ASSERT (usedChannels.size() != 0);
+       std::sort (usedChannels.begin (), usedChannels.end ());
+       usedChannels.erase (
+           std::unique (usedChannels.begin (), usedChannels.end ()),
+           usedChannels.end ());
+       if (usedChannels.back () >= 37)
+       {
+         NS_FATAL_ERROR ("CSA#2 only hops over data channels (0 to 36)");
+       }
+       bool isUsed[37] = {};
+       for (uint8_t channel : usedChannels)
+       {
+         isUsed[channel] = true;
+       }
+       return MapCsa2Channel (GetCsa2Prn (counter, channelIdentifier), 
+           isUsed, usedChannels);
+     }
+
+   void
+     BleLinkManager::FillHopTable (uint16_t base)
+     {
+       NS_LOG_FUNCTION (this << base);
+       NS_ASSERT (m_usedChannels.size() != 0);
+       uint32_t aa = this->GetAssociatedLink()->GetAccessAddress();
+       uint16_t channelIdentifier = (aa >> 16) ^ (aa & 0xFFFF);
+       // SetUsedChannels sorted the map and removed duplicates
+       if (m_usedChannels.back () >= 37)
+       {
+         NS_FATAL_ERROR ("CSA#2 only hops over data channels (0 to 36)");
+       }
+       bool isUsed[37] = {};
+       for (uint8_t channel : m_usedChannels)
+       {
+         isUsed[channel] = true;
+       }
+       for (uint32_t i = 0; i < 256; i++)
+       {
+         m_hopTable[i] = MapCsa2Channel (
+             GetCsa2Prn (base + i, channelIdentifier), isUsed, m_usedChannels);
+       }
+       m_hopTableBase = base;
+       m_hopTableValid = true;
+     }
 
    void
      BleLinkManager::ManageChannelSelection ()
      {
        NS_LOG_FUNCTION (this);
-       m_unmappedChannelIndex = (m_lastUnmappedChannelIndex + m_hopIncrement) % 37;
-       if (IsUsedChannel (m_unmappedChannelIndex)) 
-         // Is unmappedChannelIndex = used channel
+       if (m_channelSelection == CSA_2 
+           && this->GetAssociatedLink()->GetLinkType() 
+           != BleLink::LinkType::BROADCAST)
        {
-         // Select channel index
-         m_dataChannelIndex = m_unmappedChannelIndex;
+         uint16_t base = m_connEventCounter & 0xFF00;
+         if (!m_hopTableValid || m_hopTableBase != base)
+         {
+           FillHopTable (base);
+         }
+         m_dataChannelIndex = m_hopTable[m_connEventCounter & 0xFF];
        }
        else
        {
-         NS_ASSERT (m_usedChannels.size() != 0);
-         uint8_t remappingIndex = m_unmappedChannelIndex % m_usedChannels.size();
-         // Find corresponding channelIndex (m_dataChannelIndex)
-         m_dataChannelIndex = m_usedChannels.at(remappingIndex);
+         m_unmappedChannelIndex = (m_lastUnmappedChannelIndex + m_hopIncrement) % 37;
+         if (IsUsedChannel (m_unmappedChannelIndex)) 
+           // Is unmappedChannelIndex = used channel
+         {
+           // Select channel index
+           m_dataChannelIndex = m_unmappedChannelIndex;
+         }
+         else
+         {
+           NS_ASSERT (m_usedChannels.size() != 0);
+           uint8_t remappingIndex = m_unmappedChannelIndex % m_usedChannels.size();
+           // Find corresponding channelIndex (m_dataChannelIndex)
+           m_dataChannelIndex = m_usedChannels.at(remappingIndex);
+         }
+         m_lastUnmappedChannelIndex = m_unmappedChannelIndex;
        }
-       m_lastUnmappedChannelIndex = m_unmappedChannelIndex;
+       m_connEventCounter++;
       
        // Make sure PHY listens / sends on this channel
-       this->GetBBManager()->GetPhy()->SetChannel(
-           this->GetBBManager()->GetLinkController()->
-           GetChannelBasedOnChannelIndex (m_dataChannelIndex));
        this->GetBBManager()->GetPhy()->SetChannelIndex(m_dataChannelIndex);
        NS_LOG_INFO (this << " Current Channel Index is : " 
            << int(m_dataChannelIndex) );
@@ -69,6 +69,14 @@ namespace ns3 {
         CONNECTIONLESS, CONNECTED
       };
 
+      // Channel selection algorithm of connected links. Broadcast links
+      // always use CSA_1.
+      enum ChannelSelection
+      {
+        CSA_1, //!< last unmapped channel + hop increment
+        CSA_2  //!< PRN of the event counter and the access address
+      };
+
       BleLinkManager ();
       ~BleLinkManager ();
 
@@ -144,6 +152,16 @@ namespace ns3 {
        */
       bool IsInsideLastTransmitWindow (Time thisTime);
 
+      /*
+       * Returns true if the next exchange (the PDU that will be sent next,
+       * T_IFS and an empty response) ends inside the transmitWindow that
+       * was last calculated. An exchange that is longer than the whole
+       * transmitWindow (e.g. a 255 byte PDU on the S8 coded PHY) can never
+       * fit; it is only allowed as the first exchange of a window, so it
+       * overruns the window once instead of never being sent.
+       */
+      bool FitsInLastTransmitWindow (Time thisTime, bool readyForNewData);
+
       /*
        * Put packet in the queue / buffer, so it can be transmitted
        */
@@ -194,11 +212,42 @@ namespace ns3 {
 
       void ManageChannelSelection ();
 
+      /*
+       * Slave latency: a slave with nothing to send sleeps through up to
+       * connSlaveLatency connection events. Its next transmit window is
+       * only scheduled at the anchor point it wakes up at. Data that is
+       * enqueued meanwhile wakes it up at the next anchor point.
+       */
+      void NotifyDataEnqueued ();
+
+      /*
+       * Idle fast forward (attribute IdleFastForward): once master and
+       * slave exchanged only empty packets in a connection event, and the
+       * sequence numbers did not change, the following idle events are
+       * not simulated. Both ends resume at the first anchor point after
+       * data is enqueued at either of them, with hop sequence and event
+       * counter advanced.
+       */
+      // Number of connection events that were not simulated, up to now
+      uint64_t GetFastForwardedEvents ();
+      // Airtime (TX and RX) of the empty packets of those events
+      Time GetFastForwardedAirtime ();
+
       bool IsUsedChannel (uint8_t channelIndex);
+      // The map is kept sorted and without duplicates. It holds either data
+      // channels or advertising channels, anything else is a fatal error.
       void SetUsedChannels (std::vector<uint8_t> usedChannels);
 
       uint8_t GetCurrentChannelIndex ();
 
+      /*
+       * Channel selection algorithm #2 for one connection event, as
+       * ManageChannelSelection computes it. The channel identifier is the
+       * XOR of the two halves of the access address.
+       */
+      static uint8_t GetCsa2Channel (uint16_t counter, 
+          uint16_t channelIdentifier, std::vector<uint8_t> usedChannels);
+
       void SetAdvSleepCounter (uint16_t cntr);
       void SetMaxAdvSleep (uint16_t max_counter);
       void SetAdvCollisionAvoidance (bool collAvoid);
@@ -211,7 +260,6 @@ namespace ns3 {
       // function, set to true by SetLastTransmitWindowTime ()
       bool m_firstTransmitWindowDone;
 
-      EventId m_nextWindow;
       EventId m_endOfCurrentWindow;
 
       State currentState;
@@ -262,6 +310,46 @@ namespace ns3 {
       uint8_t m_hopIncrement;
       uint8_t m_dataChannelIndex;
       std::vector<uint8_t> m_usedChannels;
+
+      // Number of connection events the next transmit window is after
+      // the previous one, minus one (slave latency)
+      uint64_t m_latencySkips;
+
+      bool CanSkipConnectionEvents ();
+      void ApplySlaveLatency ();
+      // Advance hop sequence and event counter without tuning the PHY
+      void SkipConnectionEvents (uint64_t events);
+
+      // Channel selection algorithm #2 (Core spec v5.0, Vol 6, Part B, 
+      // 4.5.8.3): the channels of the 256 events that share the high byte 
+      // of the event counter are computed at once
+      ChannelSelection m_channelSelection;
+      uint8_t m_hopTable[256];
+      uint16_t m_hopTableBase; //!< event counter of the first table entry
+      bool m_hopTableValid;
+
+      void FillHopTable (uint16_t base);
+      static uint16_t GetCsa2Prn (uint16_t counter, uint16_t channelIdentifier);
+      // Map prn_e to a channel, given the used channels in ascending order
+      static uint8_t MapCsa2Channel (uint16_t prn, const bool isUsed[37],
+          const std::vector<uint8_t> &sortedUsed);
+
+      // Idle fast forward
+      bool m_idleFastForward;
+      bool m_fastForwarding;
+      Time m_ffAnchor; //!< last simulated anchor point
+      uint64_t m_ffEvents; //!< events fast forwarded in earlier idle periods
+      // Other end of a point to point link
+      Ptr<BleLinkManager> m_peerLinkManager;
+      // Whether a data packet was sent in the current window, and the
+      // sequence numbers at its start
+      bool m_windowHadData;
+      bool m_windowSn;
+      bool m_windowNesn;
+
+      bool IsIdleEvent ();
+      void StartFastForward ();
+      void StopFastForward ();
   };
 }
 #endif /* BLE_LINK_MANAGER_H */
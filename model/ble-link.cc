@@ -49,6 +49,7 @@ namespace ns3 {
     currentLinkType = UNCONNECTED;
     m_channel = 0;
     m_master = 0;
+    m_accessAddress = ADVERTISING_ACCESS_ADDRESS;
   }
 
   BleLink::~BleLink ()
@@ -70,6 +71,84 @@ namespace ns3 {
     {
       NS_LOG_FUNCTION (this);
       currentLinkType = linkType;
+      if (linkType == BROADCAST || linkType == SCANNER)
+      {
+        m_accessAddress = ADVERTISING_ACCESS_ADDRESS;
+      }
+    }
+
+  uint32_t
+    BleLink::GetAccessAddress (void) const
+    {
+      return m_accessAddress;
+    }
+
+  void
+    BleLink::SetAccessAddress (uint32_t accessAddress)
+    {
+      NS_LOG_FUNCTION (this << accessAddress);
+      m_accessAddress = accessAddress;
+    }
+
+  void
+    BleLink::GenerateAccessAddress (Ptr<UniformRandomVariable> random)
+    {
+      NS_LOG_FUNCTION (this);
+      do
+      {
+        m_accessAddress = random->GetInteger (0, 0xFFFFFFFF);
+      }
+      while (!IsValidAccessAddress (m_accessAddress));
+    }
+
+  bool
+    BleLink::IsValidAccessAddress (uint32_t aa)
+    {
+      // Not the advertising address, nor one bit away from it
+      uint32_t diff = aa ^ ADVERTISING_ACCESS_ADDRESS;
+      if ((diff & (diff - 1)) == 0)
+      {
+        return false;
+      }
+      // Not four equal octets
+      if ((aa >> 16 & 0xFFFF) == (aa & 0xFFFF) 
+          && (aa >> 8 & 0xFF) == (aa & 0xFF))
+      {
+        return false;
+      }
+      // At most six consecutive equal bits, at most 24 transitions, 
+      // at least two transitions in the six most significant bits and at
+      // most eleven in the 16 least significant bits
+      int run = 1;
+      int transitions = 0;
+      int msbTransitions = 0;
+      int lsbTransitions = 0;
+      for (int i = 1; i < 32; i++)
+      {
+        if ((aa >> i & 1) == (aa >> (i - 1) & 1))
+        {
+          if (++run > 6)
+          {
+            return false;
+          }
+          continue;
+        }
+        run = 1;
+        transitions++;
+        msbTransitions += i >= 27;
+        lsbTransitions += i < 16;
+      }
+      if (transitions > 24 || msbTransitions < 2 || lsbTransitions > 11)
+      {
+        return false;
+      }
+      // At least three ones in the least significant octet
+      int ones = 0;
+      for (int i = 0; i < 8; i++)
+      {
+        ones += aa >> i & 1;
+      }
+      return ones >= 3;
     }
 
   void
@@ -81,6 +160,10 @@ namespace ns3 {
       // //if time allows / in the future: 
       //    change this way of setting channel)
 
+      if (!c)
+      {
+        return;
+      }
       for (auto v : this->GetLinkedDevices()) // Devices are BBM
       {
         v->GetPhy()->SetChannel(c);
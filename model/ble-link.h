@@ -31,6 +31,7 @@
 #include <ns3/mac16-address.h>
 
 #include <ns3/spectrum-channel.h>
+#include <ns3/random-variable-stream.h>
 
 //#include <ns3/ble-bb-manager.h>
 
@@ -60,14 +61,48 @@ namespace ns3 {
         SCANNER
       };
 
+      /// Access address of all advertising (and broadcast) packets
+      static const uint32_t ADVERTISING_ACCESS_ADDRESS = 0x8E89BED6;
+
       BleLink ();
       ~BleLink ();
 
       static TypeId GetTypeId (void);
 
       LinkType GetLinkType();
+      /**
+       * Set the type of link. Broadcast and scanner links switch to the
+       * advertising access address.
+       */
       void SetLinkType(LinkType linkType);
 
+      /**
+       * The access address identifying the packets of this link. A new 
+       * link uses the advertising access address until a random one is
+       * generated for it.
+       */
+      uint32_t GetAccessAddress (void) const;
+      void SetAccessAddress (uint32_t accessAddress);
+
+      /**
+       * Draw random access addresses until one satisfies the rules of the
+       * spec, and use it for this link.
+       *
+       * \param random uniform stream to draw from, normally the one of the
+       *               device setting up the link
+       */
+      void GenerateAccessAddress (Ptr<UniformRandomVariable> random);
+
+      /**
+       * Check the rules a random access address must satisfy 
+       * (Core spec v5.0, Vol 6, Part B, 2.1.2), including the extra ones
+       * for the LE Coded PHY.
+       *
+       * \param accessAddress the access address
+       * \return true if it may be used for a connection
+       */
+      static bool IsValidAccessAddress (uint32_t accessAddress);
+
       void AddSlave (Ptr<BleBBManager> bleBBManager);
       void SetMaster(Ptr<BleBBManager> bleBBManager);
       Ptr<BleBBManager> GetMaster();
@@ -86,6 +121,8 @@ namespace ns3 {
 
       Ptr<SpectrumChannel> m_channel;
 
+      uint32_t m_accessAddress;
+
   };
 
 }
@@ -28,6 +28,7 @@
 #include <ns3/address-utils.h>
 #include <ns3/log.h>
 
+#include <algorithm>
 #include <list>
 #include <tuple>
 namespace ns3 {
@@ -35,17 +36,20 @@ namespace ns3 {
 NS_OBJECT_ENSURE_REGISTERED (BleMacHeader);
 NS_LOG_COMPONENT_DEFINE ("BleMacHeader");
 
+namespace {
+
+constexpr uint16_t BROADCAST_ADDRESS = 0xFFFF; //!< FF:FF
+constexpr uint16_t NULL_ADDRESS = 0x0000; //!< 00:00
+
+} // anonymous namespace
+
 
 BleMacHeader::BleMacHeader ()
+  : m_protocol (0),
+    m_llHeader (0)
 {
 	NS_LOG_FUNCTION (this);
-    SetNESN(0);
-    SetSN(0);
-    SetMD(0);
-    SetLength(0);
-    SetLLID(0);
-    SetSrcAddr("00:00");
-    SetDestAddr("00:00");
+    // Mac16Address defaults to 00:00
 }
 
 BleMacHeader::~BleMacHeader ()
@@ -53,6 +57,20 @@ BleMacHeader::~BleMacHeader ()
 	NS_LOG_FUNCTION (this);
 }
 
+const Mac16Address &
+BleMacHeader::GetBroadcastAddress (void)
+{
+  static const Mac16Address broadcast (BROADCAST_ADDRESS);
+  return broadcast;
+}
+
+const Mac16Address &
+BleMacHeader::GetNullAddress (void)
+{
+  static const Mac16Address null (NULL_ADDRESS);
+  return null;
+}
+
 /*
  * Getters And Setters
  */
@@ -80,67 +98,86 @@ BleMacHeader::GetProtocol (void) const
 void
 BleMacHeader::SetLLID (uint8_t llid)
 {
-  m_llid = llid;
+  m_llHeader = SetLlField (m_llHeader, LLID_SHIFT, 2, llid);
 }
 
 void
 BleMacHeader::SetLength (uint8_t length)
 {
   NS_LOG_FUNCTION (this);
-  m_length = length;
+  m_llHeader = SetLlField (m_llHeader, LENGTH_SHIFT, 8, length);
 }
 
 uint8_t
 BleMacHeader::GetLLID (void) const
 {
   NS_LOG_FUNCTION (this);
-  return m_llid;
+  return GetLlField (m_llHeader, LLID_SHIFT, 2);
 }
 
 uint8_t
 BleMacHeader::GetLength (void) const
 {
   NS_LOG_FUNCTION (this);
-  return m_length;
+  return GetLlField (m_llHeader, LENGTH_SHIFT, 8);
+}
+
+uint8_t
+BleMacHeader::GetLengthField (uint32_t payloadSize)
+{
+  return std::min<uint32_t> (payloadSize, 255);
 }
 
 void
 BleMacHeader::SetNESN (bool nesn)
 {
   NS_LOG_FUNCTION (this);
-  m_nesn = nesn;
+  m_llHeader = SetLlField (m_llHeader, NESN_SHIFT, 1, nesn);
 }
 
 bool
 BleMacHeader::GetNESN (void) const
 {
-  return m_nesn;
+  return GetLlField (m_llHeader, NESN_SHIFT, 1);
 }
 
 void
 BleMacHeader::SetSN (bool sn)
 {
   NS_LOG_FUNCTION (this);
-  m_sn = sn;
+  m_llHeader = SetLlField (m_llHeader, SN_SHIFT, 1, sn);
 }
 
 bool
 BleMacHeader::GetSN (void) const
 {
-  return m_sn;
+  return GetLlField (m_llHeader, SN_SHIFT, 1);
 }
 
 void
 BleMacHeader::SetMD (bool md)
 {
   NS_LOG_FUNCTION (this);
-  m_md = md;
+  m_llHeader = SetLlField (m_llHeader, MD_SHIFT, 1, md);
 }
 
 bool
 BleMacHeader::GetMD (void) const
 {
-  return m_md;
+  return GetLlField (m_llHeader, MD_SHIFT, 1);
+}
+
+void
+BleMacHeader::SetCP (bool cp)
+{
+  NS_LOG_FUNCTION (this);
+  m_llHeader = SetLlField (m_llHeader, CP_SHIFT, 1, cp);
+}
+
+bool
+BleMacHeader::GetCP (void) const
+{
+  return GetLlField (m_llHeader, CP_SHIFT, 1);
 }
 
 void
@@ -195,7 +232,12 @@ BleMacHeader::Print (std::ostream &os) const
 
   os << "Protocol = " << m_protocol 
     << ", Source Addr = " << m_src_addr
-    << ", Dest Addr = " << m_dest_addr;
+    << ", Dest Addr = " << m_dest_addr
+    << ", LLID = " << int (GetLLID ())
+    << ", NESN = " << GetNESN ()
+    << ", SN = " << GetSN ()
+    << ", MD = " << GetMD ()
+    << ", Length = " << int (GetLength ());
 }
 
 uint32_t
@@ -203,6 +245,7 @@ BleMacHeader::GetSerializedSize (void) const
 {
 	NS_LOG_FUNCTION (this);
 
+  // addresses and protocol, then the 2 octet LL header
   return 6+2; 
 }
 
@@ -215,12 +258,8 @@ BleMacHeader::Serialize (Buffer::Iterator start) const
   WriteTo (i, m_src_addr);
   WriteTo (i, m_dest_addr);
   i.WriteU16 (GetProtocol());
-  i.WriteU8 (GetLLID());
-  i.WriteU8 (
-      (this->GetLength()&0x5 << 3) |
-      (this->GetNESN()&0x1 << 2 ) |  
-      (this->GetSN()&0x1 << 1 ) |
-      (this->GetMD()&0x1 ) );
+  // LL header: first octet LLID..RFU, second octet the length
+  i.WriteHtolsbU16 (m_llHeader);
 }
 
 
@@ -234,12 +273,7 @@ BleMacHeader::Deserialize (Buffer::Iterator start)
   ReadFrom (i, m_src_addr);
   ReadFrom (i, m_dest_addr);
   SetProtocol (i.ReadU16 ());
-  SetLLID (i.ReadU8 ());
-  uint8_t temp = i.ReadU8();
-  SetLength (bool((temp >> 3) & 0x5));
-  SetNESN (bool((temp >> 2) & 0x1));
-  SetSN (bool((temp >> 1) & 0x1));
-  SetMD (bool((temp) & 0x1));
+  m_llHeader = i.ReadLsbtohU16 ();
   return i.GetDistanceFrom (start);
 }
 
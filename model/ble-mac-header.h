@@ -35,6 +35,10 @@ namespace ns3 {
 /*
  * \ingroup ble
  * Represent the Mac Header 
+ *
+ * The 16 bit LL data PDU header of the spec (LLID, NESN, SN, MD, CP, RFU
+ * and an 8 bit length), preceded by the source and destination address 
+ * and the protocol number the simulator needs to deliver the packet.
  * */
 class BleMacHeader : public Header
 {
@@ -46,6 +50,14 @@ public:
 
   ~BleMacHeader (void);
 
+  /**
+   * \return the broadcast address FF:FF
+   */
+  static const Mac16Address & GetBroadcastAddress (void);
+  /**
+   * \return the unset address 00:00
+   */
+  static const Mac16Address & GetNullAddress (void);
 
   Mac16Address GetDestAddr (void) const;
   Mac16Address GetSrcAddr (void) const;
@@ -55,8 +67,9 @@ public:
   bool GetNESN (void) const; // Get Next Expected Sequence Number bit
   bool GetSN (void) const; // Get Sequence Number bit
   bool GetMD (void) const; // Get More Data bit
+  bool GetCP (void) const; // Get CTEInfo Present bit
   uint8_t GetLLID (void) const;
-  uint8_t GetLength (void) const;
+  uint8_t GetLength (void) const; // Payload length in bytes
 
   void SetSrcAddr ( Mac16Address addr);
   void SetDestAddr ( Mac16Address addr);
@@ -66,9 +79,19 @@ public:
   void SetNESN (bool nesn);
   void SetSN (bool sn);
   void SetMD (bool md);
+  void SetCP (bool cp);
   void SetLLID (uint8_t llid);
   void SetLength (uint8_t length);
 
+  /**
+   * The length field has 8 bits: it saturates for larger payloads. The
+   * airtime is computed from the packet itself, not from the field.
+   *
+   * \param payloadSize size of the payload (bytes)
+   * \return the value of the length field, at most 255
+   */
+  static uint8_t GetLengthField (uint32_t payloadSize);
+
   std::string GetName (void) const;
   static TypeId GetTypeId (void);
   virtual TypeId GetInstanceTypeId (void) const;
@@ -77,6 +100,45 @@ public:
   void Serialize (Buffer::Iterator start) const;
   uint32_t Deserialize (Buffer::Iterator start);
 
+  /**
+   * Bit layout of the LL data PDU header, least significant bit first
+   */
+  enum LlHeaderField
+  {
+    LLID_SHIFT = 0,    //!< 2 bits
+    NESN_SHIFT = 2,
+    SN_SHIFT = 3,
+    MD_SHIFT = 4,
+    CP_SHIFT = 5,      //!< followed by 2 RFU bits
+    LENGTH_SHIFT = 8   //!< 8 bits
+  };
+
+  /**
+   * \param header a packed LL header
+   * \param shift position of the field
+   * \param bits width of the field
+   * \return the field
+   */
+  static constexpr uint16_t
+  GetLlField (uint16_t header, int shift, int bits)
+  {
+    return (header >> shift) & ((1u << bits) - 1);
+  }
+
+  /**
+   * \param header a packed LL header
+   * \param shift position of the field
+   * \param bits width of the field
+   * \param value the new value, truncated to the width of the field
+   * \return the header with the field replaced
+   */
+  static constexpr uint16_t
+  SetLlField (uint16_t header, int shift, int bits, uint16_t value)
+  {
+    return (header & ~(((1u << bits) - 1) << shift)) 
+      | ((value & ((1u << bits) - 1)) << shift);
+  }
+
 private:
   /* Addressing fields */
   Mac16Address m_src_addr;        // 0 or 8 Octet
@@ -84,12 +146,7 @@ private:
   
   uint16_t m_protocol;
 
-  bool m_nesn;
-  bool m_sn;
-  bool m_md;
-  uint8_t m_llid; // this is only 2 bits
-  uint8_t m_length; // 5 bits long
-  uint8_t m_rfu; //6 bits reserved for future use
+  uint16_t m_llHeader; // LL data PDU header, see LlHeaderField
 }; //BleMacHeader
 
 }; // namespace ns-3
@@ -112,6 +112,13 @@ namespace ns3 {
 						"This is a non-promiscuous trace,",
 						MakeTraceSourceAccessor (&BleNetDevice::m_macRxErrorTrace),
 						"ns3::Packet::TracedCallback")
+				.AddTraceSource ("MacRxHeader",
+						"A packet for this device (unicast or broadcast) has been "
+						"received, with its parsed header. The packet is passed "
+						"without the header, so sinks need not copy and "
+						"deserialize it.",
+						MakeTraceSourceAccessor (&BleNetDevice::m_macRxHeaderTrace),
+						"ns3::BleNetDevice::RxHeaderTracedCallback")
 				.AddTraceSource ("TXWindowSkipped",
 						"Two Link managers wanted to use the PHY at the same time, "
                         "so one of them needed to skip a TX window, ",
@@ -250,7 +257,7 @@ namespace ns3 {
 		BleNetDevice::GetBroadcast (void) const
 		{
 			NS_LOG_FUNCTION (this);
-			return Mac16Address ("FF:FF");
+			return BleMacHeader::GetBroadcastAddress ();
 		}
 
     // Returns tur if this device supports multicast
@@ -272,7 +279,7 @@ namespace ns3 {
 		BleNetDevice::GetMulticast (Ipv4Address addr) const
 		{
 			NS_LOG_FUNCTION (addr);
-			Mac16Address ad = Mac16Address ("FF:FF");
+			Mac16Address ad = BleMacHeader::GetBroadcastAddress ();
 			return ad;
 		}
 
@@ -280,7 +287,7 @@ namespace ns3 {
 	Address BleNetDevice::GetMulticast (Ipv6Address addr) const
 	{
 		NS_LOG_FUNCTION (addr);
-	    Mac16Address ad = Mac16Address ("FF:FF");
+	    Mac16Address ad = BleMacHeader::GetBroadcastAddress ();
 		return ad;
 	}
 
@@ -484,6 +491,16 @@ namespace ns3 {
       return this->m_bbManager;
     }
 
+  int64_t
+    BleNetDevice::AssignStreams (int64_t stream)
+    {
+      NS_LOG_FUNCTION (this << stream);
+      int64_t currentStream = stream;
+      currentStream += m_phy->AssignStreams (currentStream);
+      currentStream += m_bbManager->AssignStreams (currentStream);
+      return (currentStream - stream);
+    }
+
   void
     BleNetDevice::SetBBManager(Ptr<BleBBManager> bbManager)
     {
@@ -552,13 +569,12 @@ namespace ns3 {
 		}
 
 	void
-		BleNetDevice::NotifyReceptionEndOk (Ptr<Packet> packet)
+		BleNetDevice::NotifyReceptionEndOk (Ptr<Packet> packet, 
+            const BleMacHeader &header)
 		{
 			NS_LOG_FUNCTION (this << packet);
 
             NS_ASSERT(packet);
-			BleMacHeader header;
-			packet->PeekHeader (header);
 			NS_LOG_LOGIC ("packet : Source --> " 
                 << header.GetSrcAddr () << " Dest --> " 
                 << header.GetDestAddr()
@@ -582,20 +598,19 @@ namespace ns3 {
 
 			NS_LOG_LOGIC ("packet type = " << packetType );
             Ptr<NetDevice> nd_pointer = Ptr<BleNetDevice>(this);
-            Ptr<Packet> packet_copy1 = packet->Copy();
             short unsigned int protocol = header.GetProtocol();
             const Address src_addr = Address(header.GetSrcAddr());
             const Address dest_addr = Address(header.GetDestAddr());
-			NS_LOG_LOGIC ("packet size = " << packet_copy1->GetSize() );
-			BleMacHeader rmheader;
-			packet_copy1->RemoveHeader (rmheader);
-            Ptr<const Packet> packet_copy = packet_copy1->Copy();
+			NS_LOG_LOGIC ("packet size = " << packet->GetSize() );
 
             if (packetType == PACKET_BROADCAST )
             {
 			  m_macRxBroadcastTrace(packet, this);
-              NS_ASSERT(packet_copy);
-              m_rxCallback (nd_pointer, packet_copy, protocol, src_addr);
+              // The packet is ours alone: strip the already parsed header 
+              // in place and hand it up
+              packet->RemoveAtStart (header.GetSerializedSize ());
+              m_macRxHeaderTrace (packet, header);
+              m_rxCallback (nd_pointer, packet, protocol, src_addr);
             }
             else if (packetType != PACKET_OTHERHOST )
 			{
@@ -608,12 +623,12 @@ namespace ns3 {
                 NS_ASSERT(dest_addr.GetLength() > 0);
                 NS_ASSERT(src_addr.GetLength() == 2);
                 NS_ASSERT(dest_addr.GetLength() == 2);
-                NS_ASSERT(header.GetSrcAddr() != Mac16Address("00:00"));
-                NS_ASSERT(header.GetDestAddr() != Mac16Address("00:00"));    
-                NS_ASSERT(packet);
+                NS_ASSERT(header.GetSrcAddr() != BleMacHeader::GetNullAddress ());
+                NS_ASSERT(header.GetDestAddr() != BleMacHeader::GetNullAddress ());    
 				m_macRxTrace(packet);
-                NS_ASSERT(packet_copy);
-                m_rxCallback (nd_pointer, packet_copy, protocol, src_addr);
+                packet->RemoveAtStart (header.GetSerializedSize ());
+                m_macRxHeaderTrace (packet, header);
+                m_rxCallback (nd_pointer, packet, protocol, src_addr);
                 // m_promiscRxCallback (nd_pointer, packet_copy, 
                 //     protocol, src_addr, dest_addr, packetType);
 				Simulator::ScheduleNow(&BleBBManager::TryAgain, 
@@ -104,12 +104,23 @@ public:
   void NotifyReceptionEndError (Ptr<Packet> packet);
 
   /**
-   * Notify the MAC that the PHY finished a reception successfully
+   * Notify the MAC that the PHY finished a reception successfully.
+   * The header is removed from the packet, which is then handed to the
+   * upper layer without copying.
    *
-   * \param p the received packet
-	 * \param rssi the received signal strength of the received packet
+   * \param p the received packet, not shared with anyone else
+   * \param header the header of the packet, as parsed by the link controller
    */
-  void NotifyReceptionEndOk (Ptr<Packet> p);
+  void NotifyReceptionEndOk (Ptr<Packet> p, const BleMacHeader &header);
+
+  /**
+   * TracedCallback signature for received packets with their parsed header.
+   *
+   * \param payload the packet without its header
+   * \param header the header of the packet
+   */
+  typedef void (* RxHeaderTracedCallback)
+    (Ptr<const Packet> payload, const BleMacHeader &header);
 
 
   void NotifyTXWindowSkipped ();
@@ -196,6 +207,16 @@ public:
  
   Ptr<DropTailQueue<QueueItem>> GetQueue (void);
   Ptr<BleBBManager> GetBBManager();
+
+  /**
+   * Assign a fixed stream to the random variables of the PHY and of the
+   * BB manager. Links set up before this call keep the access addresses
+   * already drawn.
+   *
+   * \param stream first stream index to use
+   * \return the number of streams assigned
+   */
+  int64_t AssignStreams (int64_t stream);
   void SetBBManager(Ptr<BleBBManager> bbManager);
 
   Ptr<BleLinkManager> GetLinkManager();
@@ -225,6 +246,7 @@ protected:
   TracedCallback<Ptr<const Packet>, 
     Ptr<const BleNetDevice> > m_macRxBroadcastTrace;
   TracedCallback<Ptr<const Packet> > m_macRxErrorTrace;
+  TracedCallback<Ptr<const Packet>, const BleMacHeader &> m_macRxHeaderTrace;
   TracedCallback<Ptr<const BleNetDevice> > m_macTXWindowSkipped;
   
 	/**
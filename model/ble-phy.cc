@@ -24,6 +24,7 @@
 
 #include "ble-phy.h"
 #include "ble-spectrum-signal-parameters.h"
+#include "ble-spectrum-channel.h"
 #include <ns3/ble-net-device.h>
 #include <ns3/ble-bb-manager.h>
 #include <ns3/object.h>
@@ -39,6 +40,15 @@
 #include <ns3/event-id.h>
 #include <ns3/random-variable-stream.h>
 #include <ns3/double.h>
+#include <ns3/boolean.h>
+#include <ns3/enum.h>
+#include "ble-mac-header.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <map>
+#include <tuple>
+#include <vector>
 
 
 namespace ns3 {
@@ -47,6 +57,9 @@ namespace ns3 {
 
 	NS_OBJECT_ENSURE_REGISTERED (BlePhy);
 
+	const double BleSignal::LEAKAGE[BleSignal::NB_LEAKAGE_BANDS] = 
+      { 0.0059, 0.0140, 0.0787, 0.7737, 0.0787, 0.0140, 0.0059 };
+
 
 	TypeId
 		BlePhy::GetTypeId (void)
@@ -54,6 +67,35 @@ namespace ns3 {
 			static TypeId tid = TypeId ("ns3::BlePhy")
 				.SetParent<Object> ()
 				.AddConstructor<BlePhy> ()
+				.AddAttribute ("RxSensitivity",
+                    "Lowest received power (dBm) at which a signal can be "
+                    "decoded. Weaker signals only add interference. "
+                    "0 uses the sensitivity of the PhyMode.",
+                    DoubleValue (0.0),
+                    MakeDoubleAccessor (&BlePhy::m_rxSensitivity),
+                    MakeDoubleChecker<double> ())
+				.AddAttribute ("InterferenceFloor",
+                    "Received power (dBm) below which a signal is ignored, "
+                    "not even adding interference.",
+                    DoubleValue (-110.0),
+                    MakeDoubleAccessor (&BlePhy::m_interferenceFloor),
+                    MakeDoubleChecker<double> ())
+				.AddAttribute ("PhyMode",
+                    "Modulation and coding: LE 1M, LE 2M or LE Coded with "
+                    "S=2 or S=8. Unless RxSensitivity is set, it also fixes "
+                    "the sensitivity.",
+                    EnumValue (BlePhy::LE_1M),
+                    MakeEnumAccessor<BlePhy::PhyMode> (&BlePhy::SetPhyMode,
+                                                       &BlePhy::GetPhyMode),
+                    MakeEnumChecker (BlePhy::LE_1M, "LE_1M",
+                                     BlePhy::LE_2M, "LE_2M",
+                                     BlePhy::LE_CODED_S2, "LE_CODED_S2",
+                                     BlePhy::LE_CODED_S8, "LE_CODED_S8"))
+				.AddAttribute ("Encrypted",
+                    "Whether packets carry a 4 byte MIC.",
+                    BooleanValue (false),
+                    MakeBooleanAccessor (&BlePhy::m_encrypted),
+                    MakeBooleanChecker ())
 				;
 			return tid;
 		}
@@ -65,12 +107,15 @@ namespace ns3 {
 		m_k = 1.38e-23;
 		m_temperature = 273;
 		m_bandWidth = BANDWIDTH; // 100;
+		m_rxSensitivity = 0.0; // follow the PHY mode
+		m_interferenceFloor = -110.0; // dBm
 		m_antenna = 0;
-		m_bitrate = 1000000 * 4; 
-                // times 4 to allow for larger packets 
-                // (necessary for ipv4 routing protocols)  
+		m_phyMode = LE_1M;
+		m_bitrate = 1000000;
+		m_encrypted = false;
 		m_mobility = 0;
 		m_channelIndex = 20;
+		m_accessAddress = 0x8E89BED6; // advertising access address
 		m_receiver = false;
 		m_channel = 0;
 		m_netDevice = 0;
@@ -83,7 +128,7 @@ namespace ns3 {
                 // BLE specifications: min output power: 0.01 mW, max 10 mW
 		m_errorModel =Create<BleErrorModel> (); 
 		InitTxPowerSpectralDensity (m_channelIndex,m_power); //0.001);
-		m_receivingPower = Create<SpectrumValue> (m_txPsd->GetSpectrumModel ());
+		std::fill (m_receivingPower, m_receivingPower + NB_BANDS + 6, 0.0);
 	}
 
 	BlePhy::~BlePhy ()
@@ -92,6 +137,7 @@ namespace ns3 {
 		m_netDevice = 0;
 		m_mobility = 0;
 		m_channel = 0;
+		m_bleChannel = 0;
 		m_antenna = 0;
 		m_txPsd = 0;
 	}
@@ -134,8 +180,17 @@ namespace ns3 {
 		BlePhy::SetChannel (Ptr<SpectrumChannel> c)
 		{
 			NS_LOG_FUNCTION (this);
+			if (!c || c == m_channel)
+			{
+				return;
+			}
+			if (m_channel)
+			{
+				m_channel->RemoveRx(this);
+			}
 			c->AddRx(this);
 			m_channel = c;
+			m_bleChannel = DynamicCast<BleSpectrumChannel> (c);
 		}
 
     Ptr<SpectrumChannel>
@@ -144,52 +199,69 @@ namespace ns3 {
           return m_channel;
         }
 
+	Ptr<const SpectrumModel>
+		BlePhy::GetSpectrumModel (void)
+		{
+			static Ptr<const SpectrumModel> model;
+			if (!model)
+			{
+				Bands bands;
+				for (int i= 0; i < NB_BANDS+6;i++){ //0 to 40
+					BandInfo bi;
+                    bi.fc = 2402e6+(i-3)*BANDWIDTH;
+					bi.fl = bi.fc-BANDWIDTH/2;
+					bi.fh = bi.fc+BANDWIDTH/2;
+					bands.push_back (bi);
+				}
+				model = Create<SpectrumModel> (bands);
+			}
+			return model;
+		}
+
 	void
 		BlePhy::InitTxPowerSpectralDensity (uint8_t channeloffset, double power)
 		{
 			NS_LOG_FUNCTION (this);
-			Bands bands;
-			for (int i= 0; i < NB_BANDS+6;i++){ //0 to 40
-				BandInfo bi;
-                bi.fc = 2402e6+(i-3)*BANDWIDTH;
-				bi.fl = bi.fc-BANDWIDTH/2;
-				bi.fh = bi.fc+BANDWIDTH/2;
-				bands.push_back (bi);
-			}
-			Ptr<SpectrumModel> sm = Create<SpectrumModel> (bands);
-			m_txPsd = Create <SpectrumValue> (sm);
-			double txPowerDensity = power;
-//			channeloffset = 0;
-            NS_ASSERT(channeloffset >= 0);
-            NS_ASSERT(channeloffset <= 40);
-			(*m_txPsd)[channeloffset + 3] = txPowerDensity*0.7737; 
-			(*m_txPsd)[channeloffset + 2] = txPowerDensity*0.0787;
-			(*m_txPsd)[channeloffset + 1] = txPowerDensity*0.0140;
-			(*m_txPsd)[channeloffset + 0] = txPowerDensity*0.0059;
-			(*m_txPsd)[channeloffset + 4] = txPowerDensity*0.0787;
-			(*m_txPsd)[channeloffset + 5] = txPowerDensity*0.0140;
-			(*m_txPsd)[channeloffset + 6] = txPowerDensity*0.0059;
+			m_txPsd = 0;
+			SetTxPowerSpectralDensity (channeloffset, power);
 		}
 
 	void
 		BlePhy::SetTxPowerSpectralDensity (uint8_t channeloffset, double power)
 		{
 			NS_LOG_FUNCTION(this << channeloffset << power);
-			double txPowerDensity = power/m_bandWidth;
-			//reset m_txPsd
-			for (uint32_t i = 0; i<NB_BANDS+6; i++) //40
+            NS_ASSERT(channeloffset < NB_BANDS);
+            NS_ASSERT(power > 0);
+			// One row of 40 PSDs per spectrum model, power level (1 dB steps)
+			// and bandwidth, built the first time it is used and never
+			// modified afterwards: signals in flight can keep pointing to it.
+			typedef std::tuple<SpectrumModelUid_t, int, double> TxPsdKey;
+			static std::map<TxPsdKey, std::vector<Ptr<SpectrumValue> > > txPsds;
+
+			Ptr<const SpectrumModel> model = 
+              m_txPsd ? m_txPsd->GetSpectrumModel () : GetSpectrumModel ();
+			int level = (int) std::lround (10*std::log10 (power) + 30); // dBm
+			TxPsdKey key (model->GetUid (), level, m_bandWidth);
+			std::map<TxPsdKey, std::vector<Ptr<SpectrumValue> > >::iterator it = 
+              txPsds.find (key);
+			if (it == txPsds.end ())
 			{
-				(*m_txPsd)[i]=0;
+				double txPowerDensity = 
+                  std::pow (10.0, (level - 30) / 10.0)/m_bandWidth;
+				std::vector<Ptr<SpectrumValue> > row;
+				for (int channel = 0; channel < NB_BANDS; channel++)
+				{
+					Ptr<SpectrumValue> psd = Create<SpectrumValue> (model);
+					for (int k = 0; k < BleSignal::NB_LEAKAGE_BANDS; k++)
+					{
+						(*psd)[channel + k] = 
+                          txPowerDensity*BleSignal::LEAKAGE[k];
+					}
+					row.push_back (psd);
+				}
+				it = txPsds.insert (std::make_pair (key, row)).first;
 			}
-            NS_ASSERT(channeloffset >= 0);
-            NS_ASSERT(channeloffset <= 40);
-			(*m_txPsd)[channeloffset + 3] = txPowerDensity*0.7737; 
-			(*m_txPsd)[channeloffset + 2] = txPowerDensity*0.0787;
-			(*m_txPsd)[channeloffset + 1] = txPowerDensity*0.0140;
-			(*m_txPsd)[channeloffset + 0] = txPowerDensity*0.0059;
-			(*m_txPsd)[channeloffset + 4] = txPowerDensity*0.0787;
-			(*m_txPsd)[channeloffset + 5] = txPowerDensity*0.0140;
-			(*m_txPsd)[channeloffset + 6] = txPowerDensity*0.0059;
+			m_txPsd = it->second[channeloffset];
 		}
 
 	Ptr<const SpectrumModel>
@@ -204,7 +276,7 @@ namespace ns3 {
       {
         m_txPsd = 0;
         m_txPsd = Create <SpectrumValue> (model);
-        m_receivingPower = Create<SpectrumValue> (m_txPsd->GetSpectrumModel ());
+        std::fill (m_receivingPower, m_receivingPower + NB_BANDS + 6, 0.0);
       }
 
 	void
@@ -258,7 +330,7 @@ namespace ns3 {
 		}
 
 	bool
-		BlePhy::StartTx (Ptr<Packet> packet)
+		BlePhy::StartTx (Ptr<const Packet> packet)
 		{
 			NS_LOG_FUNCTION (this);
 			if(this->GetState() == BlePhy::State::TX)
@@ -266,17 +338,18 @@ namespace ns3 {
               this->ChangeState(BlePhy::State::TX_BUSY);
 				Ptr<BleSpectrumSignalParameters> txParams = 
                   Create<BleSpectrumSignalParameters> ();
-				txParams->duration = Seconds((packet->GetSize()-1)*8/m_bitrate);
+				txParams->duration = GetAirtime (packet->GetSize());
 				txParams->packet = packet;
 				txParams->txPhy = GetObject<SpectrumPhy> ();
                 SetTxPowerSpectralDensity(m_channelIndex,m_power);
 				txParams->psd = m_txPsd;
 				txParams->txAntenna = m_antenna;
 				txParams->SetChannel(m_channelIndex);
+				txParams->SetAccessAddress(m_accessAddress);
                 NS_ASSERT(m_channel);
 				m_channel->StartTx (txParams);
 				Simulator::Schedule(txParams->duration,
-                    &BlePhy::EndTx,this,packet->Copy());
+                    &BlePhy::EndTx,this,packet);
                 NS_LOG_INFO ("EndTx event scheduled in: " << txParams->duration);
 				return true;
 			}
@@ -284,7 +357,7 @@ namespace ns3 {
 		}
 
 	void 
-	BlePhy::EndTx (Ptr<Packet> packet)
+	BlePhy::EndTx (Ptr<const Packet> packet)
 	{
       NS_LOG_FUNCTION (this);
       this->ChangeState(BlePhy::State::IDLE);
@@ -379,74 +452,100 @@ namespace ns3 {
     if (this->GetState() != BlePhy::State::RX_BUSY) //m_receiver)
 			{
         NS_LOG_INFO ("[StartRx] Receiving starts now");
-        
-        // BER 업데이트
-				UpdateBer();
-        NS_LOG_DEBUG ("[StartRx] BER updated.");
 
         Ptr<BleSpectrumSignalParameters> sfParams = DynamicCast<BleSpectrumSignalParameters> (params);
+        // Only correlate on the access address of the active link: 
+        // packets of other links are interference from the preamble on
+        bool decodable = sfParams && sfParams->GetChannel() == m_channelIndex
+          && sfParams->GetAccessAddress() == m_accessAddress;
 
-        // 수신 신호의 파워를 추가
-				*m_receivingPower += *params->psd;
+        // 수신 신호의 파워를 추가하고 노이즈 종료 스케줄링
+        if (sfParams)
+        {
+          BleSignal signal;
+          signal.channel = sfParams->GetChannel();
+          signal.density = 
+            (*params->psd)[signal.channel + 3] / BleSignal::LEAKAGE[3];
+          double power = signal.density*m_bandWidth;
+          sfParams->SetRxPower (power, (*params->psd)[signal.channel + 3]);
+          double rxPowerDbm = 10*std::log10 (power) + 30;
+          if (rxPowerDbm < m_interferenceFloor)
+          {
+            NS_LOG_LOGIC ("[StartRx] Signal of " << rxPowerDbm 
+                << " dBm below interference floor, ignored.");
+            return;
+          }
+          decodable = decodable && rxPowerDbm >= GetRxSensitivity ();
+          AddReceivingPower (signal, 1);
+          UpdateSegments (signal.channel);
+          Simulator::Schedule(params->duration, &BlePhy::EndNoise, this, signal);
+
+          // Corrupt the ongoing receptions this signal is too strong for, 
+          // and the new reception if a signal already on air is
+          for (auto &it : m_params)
+          {
+            if (it->GetRxPower() 
+                < GetRejection (it->GetChannel(), signal.channel)*power)
+            {
+              it->SetBer(10);
+              NS_LOG_WARN ("[StartRx] Collision detected. Ongoing reception on channel "
+                  << static_cast<int>(it->GetChannel()) << " corrupted.");
+            }
+          }
+          if (decodable)
+          {
+            sfParams->SetBer(0);
+            for (auto &other : m_signals)
+            {
+              if (power < GetRejection (signal.channel, other.channel)
+                            *other.density*m_bandWidth)
+              {
+                sfParams->SetBer(10);
+                NS_LOG_WARN ("[StartRx] Collision detected. Incoming signal corrupted "
+                    "by a signal on channel " << static_cast<int>(other.channel));
+                break;
+              }
+            }
+          }
+          m_signals.push_back (signal);
+        }
+        else
+        {
+          if (10*std::log10 (Integral (*params->psd)) + 30 < m_interferenceFloor)
+          {
+            NS_LOG_LOGIC ("[StartRx] Signal below interference floor, ignored.");
+            return;
+          }
+          Values::const_iterator v = params->psd->ConstValuesBegin ();
+          for (int i = 0; 
+               i < NB_BANDS + 6 && v != params->psd->ConstValuesEnd (); i++, v++)
+          {
+            m_receivingPower[i] += *v;
+          }
+          UpdateSegments (-1);
+          Simulator::Schedule(params->duration, 
+              &BlePhy::EndForeignNoise, this, params->psd);
+        }
         NS_LOG_DEBUG ("[StartRx] Added received power to m_receivingPower.");
 
-        // 노이즈 종료 스케줄링
-        Simulator::Schedule(params->duration, &BlePhy::EndNoise, this, params->psd);
-
-        if (sfParams)
+        // A signal on another channel only leaks into this one, and a signal
+        // below the sensitivity cannot be decoded
+        if (decodable)
         {
 					uint8_t channel = sfParams->GetChannel();
             NS_LOG_DEBUG ("[StartRx] Signal received on channel " << static_cast<int>(channel));
+            sfParams->AddSegment (Simulator::Now (), m_receivingPower[channel + 3], 
+                                  m_channelIndex == channel);
 
-            if (m_params.size() < 1)
-            {
-                // 첫 번째 신호 처리
-						m_params.push_back(sfParams);
-						sfParams->SetBer(0);
-                sfParams->SetEvent(Simulator::Schedule(sfParams->duration, &BlePhy::EndRx, this, sfParams));
-                NS_LOG_INFO ("[StartRx] No collision detected. First signal processed on channel "
-                             << static_cast<int>(channel));
-            }
-            else
-            {
-                // 채널 충돌 검사
-						sfParams->SetBer(0);
-                sfParams->SetEvent(Simulator::Schedule(sfParams->duration, &BlePhy::EndRx, this, sfParams));
-
-						for (auto &it : m_params)
-						{
-                    NS_LOG_DEBUG ("[StartRx] Checking for collision with signal on channel "
-                                  << static_cast<int>(it->GetChannel()));
-
-                    if (it->GetChannel() == channel)
-                    {
-                        double ccrejection = 12.6; // Co-channel rejection threshold
-
-                        // 충돌 처리
-                        if (Integral(*it->psd) * ccrejection < Integral(*sfParams->psd))
-                        {
-									it->SetBer(10);
-                            NS_LOG_WARN ("[StartRx] Collision detected. Lower power signal corrupted.");
-                        }
-                        else if (Integral(*it->psd) > ccrejection * Integral(*sfParams->psd))
-                        {
-										sfParams->SetBer(10);
-                            NS_LOG_WARN ("[StartRx] Collision detected. Incoming signal corrupted due to higher power.");
-									}
-									else
-									{
-										sfParams->SetBer(10);
-										it->SetBer(10);
-                            NS_LOG_WARN ("[StartRx] Collision detected. Both signals corrupted.");
-								}
-							}
-						}
-						m_params.push_back(sfParams);
-					}
+            sfParams->SetEvent(Simulator::Schedule(sfParams->duration, &BlePhy::EndRx, this, sfParams));
+            m_params.push_back(sfParams);
+            NS_LOG_INFO ("[StartRx] Reception started on channel "
+                         << static_cast<int>(channel));
         }
 		else
 		{
-			NS_LOG_INFO("[StartRx] could not parse packet.");
+			NS_LOG_INFO("[StartRx] not a BLE signal of the active link on channel " 
+                << static_cast<int>(m_channelIndex) << ", only interference.");
 				}
 			}
             else
@@ -458,11 +557,72 @@ namespace ns3 {
 
 
 	void
-		BlePhy::EndNoise (Ptr<SpectrumValue> sv)
+		BlePhy::EndNoise (BleSignal signal)
+		{
+			NS_LOG_FUNCTION(this);
+			// Entries with the same channel and density are interchangeable
+			for (std::size_t i = 0; i < m_signals.size(); i++)
+			{
+				if (m_signals[i].channel == signal.channel 
+                    && m_signals[i].density == signal.density)
+				{
+					m_signals[i] = m_signals.back();
+					m_signals.pop_back();
+					break;
+				}
+			}
+			AddReceivingPower (signal, -1);
+			UpdateSegments (signal.channel);
+		}
+
+	double
+		BlePhy::GetRejection (uint8_t wanted, uint8_t interferer)
+		{
+			// C/I (as a power ratio) a reception must exceed, per channel 
+			// offset: co-channel 11 dB, adjacent (2 MHz) -17 dB, 
+			// 4 and 6 MHz -27 dB. Further signals do not reach the receiver.
+			static double rejection[NB_BANDS][NB_BANDS];
+			static bool built = false;
+			if (!built)
+			{
+				for (int a = 0; a < NB_BANDS; a++)
+				{
+					for (int b = 0; b < NB_BANDS; b++)
+					{
+						int offset = std::abs (a - b);
+						rejection[a][b] = offset == 0 ? 12.6 
+                          : offset == 1 ? std::pow (10.0, -1.7)
+                          : offset <= 3 ? std::pow (10.0, -2.7) : 0.0;
+					}
+				}
+				built = true;
+			}
+			NS_ASSERT (wanted < NB_BANDS && interferer < NB_BANDS);
+			return rejection[wanted][interferer];
+		}
+
+	void
+		BlePhy::EndForeignNoise (Ptr<SpectrumValue> sv)
 		{
 			NS_LOG_FUNCTION(this);
-			UpdateBer();
-			*m_receivingPower -= *sv;
+			Values::const_iterator v = sv->ConstValuesBegin ();
+			for (int i = 0; i < NB_BANDS + 6 && v != sv->ConstValuesEnd (); i++, v++)
+			{
+				m_receivingPower[i] -= *v;
+			}
+			UpdateSegments (-1);
+		}
+
+	void
+		BlePhy::AddReceivingPower (const BleSignal &signal, double scale)
+		{
+			NS_ASSERT (signal.channel + BleSignal::NB_LEAKAGE_BANDS <= NB_BANDS + 6);
+			double density = scale * signal.density;
+			for (int k = 0; k < BleSignal::NB_LEAKAGE_BANDS; k++)
+			{
+				m_receivingPower[signal.channel + k] += 
+                  density * BleSignal::LEAKAGE[k];
+			}
 		}
 
 	void 
@@ -478,8 +638,8 @@ namespace ns3 {
 				return;
 			}
 
-			//update BER
-			UpdateBer();
+			//evaluate bit errors over the whole reception
+			params->SetBer(GetBitErrors(params)+params->GetBer());
 			int temp = 0;
 			for (auto &it : m_params)
 			{
@@ -491,16 +651,17 @@ namespace ns3 {
 			}
 			//decide packet error or not
 			//if(m_random->GetValue()>=per)
+			//the packet is shared with all receivers, hand over a copy
 			if(params->GetBer()<1)
 			{
 				//no packet error
-				m_ReceptionEnd(params->packet, false);
+				m_ReceptionEnd(params->packet->Copy(), false);
 			}
 			else
 			{
 				NS_LOG_INFO("packet error.");
 				//packet error
-				m_ReceptionEnd(params->packet, true);
+				m_ReceptionEnd(params->packet->Copy(), true);
 			}
             this->ChangeState(BlePhy::State::IDLE);
 		}
@@ -557,14 +718,109 @@ namespace ns3 {
        m_bandWidth = bandwidth;
      }
 
+   void
+     BlePhy::SetAccessAddress (uint32_t accessAddress)
+     {
+       NS_LOG_FUNCTION (this << accessAddress);
+       m_accessAddress = accessAddress;
+     }
+
+   uint32_t
+     BlePhy::GetAccessAddress (void) const
+     {
+       return m_accessAddress;
+     }
+
+   void
+     BlePhy::SetPhyMode (PhyMode mode)
+     {
+       NS_LOG_FUNCTION (this << mode);
+       m_phyMode = mode;
+       m_bitrate = (mode == LE_2M) ? 2000000 : 1000000/GetCoding ();
+     }
+
+   uint8_t
+     BlePhy::GetCoding (void) const
+     {
+       switch (m_phyMode)
+         {
+         case LE_CODED_S2:
+           return 2;
+         case LE_CODED_S8:
+           return 8;
+         default:
+           return 1;
+         }
+     }
+
+   BlePhy::PhyMode
+     BlePhy::GetPhyMode (void) const
+     {
+       return m_phyMode;
+     }
+
+   double
+     BlePhy::GetRxSensitivity (void) const
+     {
+       if (m_rxSensitivity != 0)
+         {
+           return m_rxSensitivity;
+         }
+       switch (m_phyMode)
+         {
+         case LE_2M:
+           return -92.0;
+         case LE_CODED_S2:
+           return -99.0;
+         case LE_CODED_S8:
+           return -103.0;
+         default:
+           return -95.0;
+         }
+     }
+
+   Time
+     BlePhy::GetAirtime (uint32_t packetSize) const
+     {
+       uint32_t header = BleMacHeader ().GetSerializedSize ();
+       uint32_t payload = packetSize > header ? packetSize - header : 0;
+       uint32_t mic = m_encrypted ? 4 : 0;
+       uint8_t coding = GetCoding ();
+       if (coding > 1)
+         {
+           // preamble + access address + CI + TERM1, then the coded PDU:
+           // LL header + payload + MIC + CRC, followed by TERM2 (3 bits)
+           uint32_t pduBits = (2 + payload + mic + 3)*8 + 3;
+           return MicroSeconds (80 + 256 + 16 + 24 + pduBits*coding);
+         }
+       uint32_t preamble = (m_phyMode == LE_2M) ? 2 : 1;
+       // preamble + access address + LL header + payload + MIC + CRC
+       uint32_t bytes = preamble + 4 + 2 + payload + mic + 3;
+       return Seconds (bytes*8/m_bitrate);
+     }
+
    void
      BlePhy::SetChannelIndex (uint8_t channelIndex)
      {
-        m_channelIndex = channelIndex;
+        if (m_channelIndex != channelIndex)
+        {
+          m_channelIndex = channelIndex;
+          if (m_bleChannel)
+          {
+            m_bleChannel->Retune (this);
+          }
+          UpdateSegments (-1);
+        }
+     }
+
+   uint8_t
+     BlePhy::GetChannelIndex (void) const
+     {
+        return m_channelIndex;
      }
 
    bool
-    BlePhy::PrepareTX (Ptr<Packet> packet)
+    BlePhy::PrepareTX (Ptr<const Packet> packet)
     {
 			NS_LOG_FUNCTION(this);
 
@@ -621,37 +877,59 @@ namespace ns3 {
     }
 
   void 
-		BlePhy::UpdateBer ()
+		BlePhy::UpdateSegments (int channel)
 		{
-			double timeNow = Simulator::Now().GetSeconds(); 
+			Time now = Simulator::Now();
 			for (auto &i : m_params) {
-              uint8_t paramsChannelIndex = i->GetChannel();
-              if (m_channelIndex == paramsChannelIndex )
+              int paramsChannelIndex = i->GetChannel();
+              if (channel < 0 || std::abs (paramsChannelIndex - channel) 
+                  <= BleSignal::NB_LEAKAGE_BANDS / 2)
               {
-				int m_bitErrors = 0;
-				//calculate SNR
-				Ptr<SpectrumValue> noise = m_receivingPower->Copy();
-				*noise -= *i->psd;
-				uint32_t channel = i->GetChannel();
-				double snr = 
-                  (*i->psd)[channel+3]/((*noise)[channel+3]+m_k*m_temperature);
-				//getBER
-				long double berEs = m_errorModel->GetBER (snr);
-				int bits = (timeNow - m_lastCheck)*m_bitrate / 4; 
-                // Divided by 4 to compensate for higher bitrate 
-                //  (see other remark at bitrate instantiation)
-				for ( int it = 0; it < bits; it++)
+				i->AddSegment (now, m_receivingPower[paramsChannelIndex + 3],
+                               m_channelIndex == paramsChannelIndex);
+              }
+			}
+		}
+
+  uint32_t
+		BlePhy::GetBitErrors (Ptr<BleSpectrumSignalParameters> params)
+		{
+			double signal = params->GetInChannelPower();
+			const std::vector<BleSpectrumSignalParameters::Segment> &segments = 
+              params->GetSegments();
+			Time now = Simulator::Now();
+			// SNR (dB) and length of every tuned segment, scored in one batch.
+			// The scratch vectors keep their capacity between receptions.
+			m_snrDb.clear ();
+			m_segmentBits.clear ();
+			for (std::size_t s = 0; s < segments.size(); s++)
+			{
+				if (!segments[s].tuned)
 				{
-					if(m_random->GetValue()<berEs)
-					{
-						//calculate numbers of biterrors	
-						m_bitErrors += 1;
-					}
+					continue;
 				}
-				i->SetBer(m_bitErrors+i->GetBer());
-              }
+				Time end = s + 1 < segments.size() ? segments[s + 1].start : now;
+				int n = (end - segments[s].start).GetSeconds()*m_bitrate;
+				if (n <= 0)
+				{
+					continue;
+				}
+				//calculate SNR
+				// clamp rounding residue left by adding and removing signals
+				double noise = std::max (segments[s].power - signal, 0.0);
+				m_snrDb.push_back (10*std::log10 (signal/(noise+m_k*m_temperature)));
+				m_segmentBits.push_back (n);
+			}
+			m_ber.resize (m_snrDb.size());
+			m_errorModel->GetBER (m_snrDb.data(), m_ber.data(), m_snrDb.size(), 
+                                  GetCoding ());
+			uint32_t bitErrors = 0;
+			for (std::size_t s = 0; s < m_ber.size(); s++)
+			{
+				bitErrors += m_errorModel->GetBitErrors (m_ber[s], m_segmentBits[s], 
+                                                         m_random);
 			}
-			m_lastCheck = timeNow;
+			return bitErrors;
 		}
 
 		void
@@ -660,4 +938,13 @@ namespace ns3 {
 				m_receiver = receiver;
 			}
 
+		int64_t
+			BlePhy::AssignStreams (int64_t stream)
+			{
+				NS_LOG_FUNCTION (this << stream);
+				m_random->SetStream (stream);
+				m_channelSelector->SetStream (stream + 1);
+				return 2;
+			}
+
 		} // namespace
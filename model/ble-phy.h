@@ -52,6 +52,24 @@ class NetDevice;
 struct SpectrumSignalParameters;
 
 class BleBBManager;
+class BleSpectrumChannel;
+
+/**
+ * \ingroup ble
+ *
+ * Compact description of a BLE signal at a receiver. A BLE transmission
+ * only occupies the seven bands around its channel, with fixed leakage
+ * weights, so its power spectral density is fully given by its channel and
+ * one scalar.
+ */
+struct BleSignal
+{
+  static const int NB_LEAKAGE_BANDS = 7; //!< bands covered by one signal
+  static const double LEAKAGE[NB_LEAKAGE_BANDS]; //!< weight of band channel+k
+
+  uint8_t channel; //!< channel index, the signal covers bands channel..channel+6
+  double density;  //!< received power spectral density (W/Hz) before weighting
+};
 
 /**
  * \ingroup spectrum
@@ -78,6 +96,17 @@ public:
     RX_BUSY 
   };
 
+  /**
+   * Modulation and symbol rate of the PHY
+   */
+  enum PhyMode
+  {
+    LE_1M,       //!< uncoded, 1 Msym/s
+    LE_2M,       //!< uncoded, 2 Msym/s
+    LE_CODED_S2, //!< 1 Msym/s, FEC with S=2 (500 kbit/s)
+    LE_CODED_S8  //!< 1 Msym/s, FEC with S=8 (125 kbit/s)
+  };
+
   static TypeId GetTypeId (void);
 
   /**
@@ -110,9 +139,10 @@ public:
   Ptr<MobilityModel> GetMobility () const;
 
   /**
-   * Set the channel attached to this device.
+   * Set the channel attached to this device. The PHY is removed from the
+   * channel it was attached to before.
    *
-   * @param c the channel
+   * @param c the channel, ignored if null
    */
   void SetChannel (Ptr<SpectrumChannel> c);
   Ptr<SpectrumChannel> GetChannel();
@@ -127,12 +157,30 @@ public:
   void SetRxSpectrumModel (Ptr<const SpectrumModel> model);
 
   /**
-   * Set the Tx power spectrum by setting channel and power
+   * The SpectrumModel shared by all BLE PHYs: the 40 BLE channels of 2 MHz,
+   * plus 3 bands on either side for the leakage of the edge channels.
+   * It is built on first use.
+   *
+   * @return the BLE SpectrumModel
+   */
+  static Ptr<const SpectrumModel> GetSpectrumModel (void);
+
+  /**
+   * Set the Tx power spectrum by setting channel and power, 
+   * using the shared BLE SpectrumModel
    *
    * @param channeloffset number of channel used
    * @param power total radiated power
    */
    void InitTxPowerSpectralDensity (uint8_t channeloffset, double power);
+
+  /**
+   * Point the Tx power spectrum to the shared, read-only PSD for a channel
+   * and power. The power is rounded to the nearest dBm.
+   *
+   * @param channeloffset number of channel used
+   * @param power total radiated power (W)
+   */
    void SetTxPowerSpectralDensity (uint8_t channeloffset, double power);
 
   /**
@@ -164,7 +212,20 @@ public:
    * @param params the parameters of the signals being received
    */
   void EndRx (Ptr<SpectrumSignalParameters> params);
-  void EndNoise (Ptr<SpectrumValue> sv);
+
+  /**
+   * Remove an ended BLE signal from the power at the receiving antenna.
+   *
+   * @param signal the signal that ended
+   */
+  void EndNoise (BleSignal signal);
+
+  /**
+   * Remove an ended non-BLE signal from the power at the receiving antenna.
+   *
+   * @param sv the received power spectral density of the signal
+   */
+  void EndForeignNoise (Ptr<SpectrumValue> sv);
   /**
    *
    */
@@ -188,23 +249,77 @@ public:
   /**
    *
    */
-  bool StartTx (Ptr<Packet> packet);
-  void EndTx (Ptr<Packet> packet);
+  bool StartTx (Ptr<const Packet> packet);
+  void EndTx (Ptr<const Packet> packet);
   /**
    *
    */
   void SetReceiverMode (bool receiver);
 
+  /**
+   * Assign a fixed stream to the random variables of the PHY: the bit
+   * error draws and the channel selector.
+   *
+   * @param stream first stream index to use
+   * @return the number of streams assigned
+   */
+  int64_t AssignStreams (int64_t stream);
+
   void SetChannelIndex(uint8_t channelIndex);
+  uint8_t GetChannelIndex (void) const;
+
+  /**
+   * Set the access address sent with, and correlated on for, every packet.
+   * A signal with another access address is only interference: it is
+   * never decoded nor handed to the upper layers.
+   *
+   * @param accessAddress the access address of the active link
+   */
+  void SetAccessAddress (uint32_t accessAddress);
+  uint32_t GetAccessAddress (void) const;
   void SetPower (double power);
   void SetBandwidth (uint32_t bandwidth);
 
+  /**
+   * Set the PHY mode, which fixes the bitrate, the packet format and the
+   * error curve.
+   *
+   * @param mode the PHY mode
+   */
+  void SetPhyMode (PhyMode mode);
+  PhyMode GetPhyMode (void) const;
+
+  /**
+   * Lowest received power at which a signal can be decoded: the
+   * RxSensitivity attribute if it is set, otherwise the reference
+   * sensitivity of the PHY mode (-95 dBm on LE 1M, -92 dBm on LE 2M,
+   * -99 dBm on LE Coded S=2 and -103 dBm on LE Coded S=8).
+   *
+   * @return the sensitivity (dBm)
+   */
+  double GetRxSensitivity (void) const;
+
+  /**
+   * Time on air of a packet in the current PHY mode: preamble, access 
+   * address, 2 byte LL header, payload, MIC (encrypted links only) and CRC.
+   * On the coded PHY the preamble (80 us), access address (256 us), CI 
+   * (16 us) and TERM1 (24 us) are always sent with S=8, the rest of the 
+   * packet and TERM2 with the coding of the mode.
+   * The payload is the packet without its BleMacHeader. T_IFS and the radio
+   * startup times do not depend on the PHY mode and are not included.
+   *
+   * @param packetSize size of the packet, including its BleMacHeader (bytes)
+   * @return the airtime
+   */
+  Time GetAirtime (uint32_t packetSize) const;
+
 
   BlePhy::State GetState ();
   void ChangeState (BlePhy::State state);
 
   // TX states
-  bool PrepareTX (Ptr<Packet> packet); // Startup transmitter
+  bool PrepareTX (Ptr<const Packet> packet); // Startup transmitter,
+                                             // the packet is not modified
   
   // RX states
   bool PrepareRX (); // Startup receiver and look for preamble
@@ -215,7 +330,8 @@ private:
  Ptr<NetDevice> m_netDevice; //upper layer
  Ptr<MobilityModel> m_mobility; //position
  Ptr<SpectrumChannel> m_channel; //channel to transmit on
- Ptr<SpectrumValue> m_txPsd; //Current transmit psd
+ Ptr<BleSpectrumChannel> m_bleChannel; //m_channel, if it indexes receivers
+ Ptr<SpectrumValue> m_txPsd; //Current transmit psd (shared, do not modify)
  Ptr<AntennaModel> m_antenna; //antenna to be used
  bool m_receiver; // whether or not this physical layer 
                   // is a sender or receiver 
@@ -223,17 +339,26 @@ private:
  double m_k; //boltzman
  double m_temperature; //noise temperature
  double m_bandWidth; //bandwith
- double m_bitrate; //bitrate
+ double m_bitrate; //bitrate (bit/s) of the PDU, given by m_phyMode
+ PhyMode m_phyMode; //modulation and symbol rate
+ bool m_encrypted; //whether packets carry a MIC
  double m_power; //power of transmission
+ double m_rxSensitivity; //sensitivity override (dBm), 0 to follow m_phyMode
+ double m_interferenceFloor; //lowest received power (dBm) that interferes
  uint8_t m_channelIndex; //channel to transmit on
+ uint32_t m_accessAddress; //access address of the active link
  double m_bitErrors[40]; //biterrors collected 
  std::vector <Ptr<BleSpectrumSignalParameters> > m_params; 
             //all transmissions that are happening at the moment
+ std::vector<BleSignal> m_signals; //all BLE signals at the receiving antenna
  EventId m_events[40]; //current receiving events for sending
- double m_lastCheck; //last time check
  double m_equivalentNoiseTemperature; //noise temperature
- Ptr<SpectrumValue> m_receivingPower; //all the power at the receiving antenna
+ double m_receivingPower[NB_BANDS + 6]; //all the power at the receiving 
+                                        //antenna, per band (W/Hz)
  Ptr<BleErrorModel> m_errorModel; // error model for this device
+ std::vector<double> m_snrDb; //scratch: SNR (dB) of the scored segments
+ std::vector<double> m_ber; //scratch: BER of the scored segments
+ std::vector<uint32_t> m_segmentBits; //scratch: bits in the scored segments
  Ptr<UniformRandomVariable> m_random; //determines whether received package 
                                       //is lost are not
  Ptr<UniformRandomVariable> m_channelSelector; //selects the channel
@@ -258,9 +383,47 @@ private:
   void CreateTxPowerSpectralDensity (uint32_t channeloffset, double power);
 
   /**
-   * Update the BER for all receiving transmissions based on latest information 
+   * Add a BLE signal to (or, with a negative scale, remove it from) the power
+   * at the receiving antenna. Only the bands the signal covers are touched.
+   *
+   * @param signal the signal
+   * @param scale 1 to add the signal, -1 to remove it
+   */
+  void AddReceivingPower (const BleSignal &signal, double scale);
+
+  /**
+   * Co-channel and adjacent channel rejection. A reception is corrupted by
+   * a signal when its power is below the returned ratio times the power of
+   * the signal. The 40x40 table is built on first use.
+   *
+   * @param wanted channel index of the reception
+   * @param interferer channel index of the interfering signal
+   * @return the C/I (power ratio) the reception needs, 0 if no limit
+   */
+  static double GetRejection (uint8_t wanted, uint8_t interferer);
+
+  /**
+   * Start a new interference segment for every ongoing reception whose
+   * centre band is covered by a signal on the given channel.
+   *
+   * @param channel channel of the signal that started or ended, 
+   *                or -1 for a signal that covers all bands
+   */
+  void UpdateSegments (int channel);
+
+  /**
+   * Draw the number of bit errors of a reception from the interference 
+   * segments recorded while it was ongoing.
+   *
+   * @param params the reception, ending now
+   * @return the number of bit errors
+   */
+  uint32_t GetBitErrors (Ptr<BleSpectrumSignalParameters> params);
+
+  /**
+   * @return the coding factor S of the current PHY mode, 1 if uncoded
    */
-  void UpdateBer (void);
+  uint8_t GetCoding (void) const;
 };
 
 
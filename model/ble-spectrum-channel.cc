@@ -0,0 +1,826 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#include "ble-spectrum-channel.h"
+#include "ble-spectrum-signal-parameters.h"
+#include <ns3/log.h>
+#include <ns3/boolean.h>
+#include <ns3/double.h>
+#include <ns3/uinteger.h>
+#include <ns3/simulator.h>
+#include <ns3/node.h>
+#include <ns3/net-device.h>
+#include <ns3/mobility-model.h>
+#include <ns3/constant-position-mobility-model.h>
+#include <ns3/antenna-model.h>
+#include <ns3/angles.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/propagation-delay-model.h>
+#include <ns3/spectrum-propagation-loss-model.h>
+#include <ns3/spectrum-transmit-filter.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iterator>
+#include <string>
+
+namespace ns3 {
+
+  NS_LOG_COMPONENT_DEFINE ("BleSpectrumChannel");
+
+  NS_OBJECT_ENSURE_REGISTERED (BleSpectrumChannel);
+
+  /**
+   * \param x column of a grid cell
+   * \param y row of a grid cell
+   * \return the key of the cell
+   */
+  static uint64_t
+    PackCell (int64_t x, int64_t y)
+    {
+      return ((uint64_t) (uint32_t) x << 32) | (uint32_t) y;
+    }
+
+  TypeId
+    BleSpectrumChannel::GetTypeId (void)
+    {
+      static TypeId tid = TypeId ("ns3::BleSpectrumChannel")
+        .SetParent<SpectrumChannel> ()
+        .SetGroupName ("Ble")
+        .AddConstructor<BleSpectrumChannel> ()
+        .AddAttribute ("CachePathLoss",
+                       "Reuse the path loss between two PHYs until one of "
+                       "them changes course. Suspended while the loss model "
+                       "chain holds a model that is not known to be "
+                       "deterministic.",
+                       BooleanValue (false),
+                       MakeBooleanAccessor (&BleSpectrumChannel::m_cachePathLoss),
+                       MakeBooleanChecker ())
+        .AddAttribute ("MaxCachedPathLosses",
+                       "Number of cached path losses at which the cache is "
+                       "emptied.",
+                       UintegerValue (1000000),
+                       MakeUintegerAccessor (
+                         &BleSpectrumChannel::m_maxCachedPathLosses),
+                       MakeUintegerChecker<uint32_t> (1))
+        .AddAttribute ("SpatialIndex",
+                       "Only offer BLE signals to static receivers in the "
+                       "grid cells within reach of the sender. Only valid "
+                       "for deterministic propagation loss models.",
+                       BooleanValue (false),
+                       MakeBooleanAccessor (&BleSpectrumChannel::m_spatialIndex),
+                       MakeBooleanChecker ())
+        .AddAttribute ("MaxTxPower",
+                       "Highest transmit power (dBm) of the devices, "
+                       "used to size the spatial grid.",
+                       DoubleValue (10.0),
+                       MakeDoubleAccessor (&BleSpectrumChannel::m_maxTxPower),
+                       MakeDoubleChecker<double> ())
+        .AddAttribute ("ReachThreshold",
+                       "Received power (dBm) below which a signal has no "
+                       "effect on a receiver, used to size the spatial grid.",
+                       DoubleValue (-110.0),
+                       MakeDoubleAccessor (&BleSpectrumChannel::m_reachThreshold),
+                       MakeDoubleChecker<double> ())
+        ;
+      return tid;
+    }
+
+  BleSpectrumChannel::BleSpectrumChannel ()
+  {
+    NS_LOG_FUNCTION (this);
+    m_cachePathLoss = false;
+    m_maxCachedPathLosses = 1000000;
+    m_deterministicLoss = false;
+    m_spatialIndex = false;
+    m_maxTxPower = 10.0;
+    m_reachThreshold = -110.0;
+    m_gridBuilt = false;
+    m_cellSize = 0;
+  }
+
+  BleSpectrumChannel::~BleSpectrumChannel ()
+  {
+    NS_LOG_FUNCTION (this);
+  }
+
+  void
+    BleSpectrumChannel::DoDispose (void)
+    {
+      NS_LOG_FUNCTION (this);
+      m_phyList.clear ();
+      for (int i = 0; i < NB_BANDS; i++)
+      {
+        m_buckets[i].clear ();
+      }
+      m_slots.clear ();
+      m_otherPhys.clear ();
+      for (auto &mobility : m_trackedMobility)
+      {
+        mobility->TraceDisconnectWithoutContext ("CourseChange",
+            MakeCallback (&BleSpectrumChannel::CourseChanged, this));
+      }
+      m_trackedMobility.clear ();
+      m_tracked.clear ();
+      m_pathLossCache.clear ();
+      m_cachedPairs.clear ();
+      m_checkedLoss = 0;
+      m_checkedDelay = 0;
+      m_grid.clear ();
+      m_unplaced.clear ();
+      m_gridSlots.clear ();
+      m_mobilityPhys.clear ();
+      m_mobilitySlots.clear ();
+      SpectrumChannel::DoDispose ();
+    }
+
+  void
+    BleSpectrumChannel::AddRx (Ptr<SpectrumPhy> phy)
+    {
+      NS_LOG_FUNCTION (this << phy);
+      NS_ASSERT (std::find (m_phyList.begin (), m_phyList.end (), phy)
+          == m_phyList.end ());
+      m_phyList.push_back (phy);
+
+      Ptr<BlePhy> blePhy = DynamicCast<BlePhy> (phy);
+      if (blePhy)
+      {
+        uint8_t channelIndex = blePhy->GetChannelIndex ();
+        NS_ASSERT (channelIndex < NB_BANDS);
+        m_slots[PeekPointer (blePhy)] =
+          std::make_pair (channelIndex, m_buckets[channelIndex].size ());
+        m_buckets[channelIndex].push_back (blePhy);
+        if (m_cellSize > 0)
+        {
+          Ptr<MobilityModel> mobility = blePhy->GetMobility ();
+          if (mobility)
+          {
+            // makes sure course changes are followed
+            TrackMobility (mobility);
+            AddMobilityPhy (blePhy, mobility);
+          }
+          AddToGrid (blePhy);
+        }
+      }
+      else
+      {
+        m_otherPhys.push_back (phy);
+      }
+    }
+
+  void
+    BleSpectrumChannel::RemoveRx (Ptr<SpectrumPhy> phy)
+    {
+      NS_LOG_FUNCTION (this << phy);
+      std::vector<Ptr<SpectrumPhy> >::iterator it =
+        std::find (m_phyList.begin (), m_phyList.end (), phy);
+      if (it == m_phyList.end ())
+      {
+        return;
+      }
+      m_phyList.erase (it);
+      // A later PHY may get the same address
+      Ptr<MobilityModel> mobility = phy->GetMobility ();
+      if (mobility)
+      {
+        ForgetPathLosses (PeekPointer (mobility));
+      }
+
+      Ptr<BlePhy> blePhy = DynamicCast<BlePhy> (phy);
+      if (blePhy)
+      {
+        RemoveFromBucket (PeekPointer (blePhy));
+        m_slots.erase (PeekPointer (blePhy));
+        if (m_gridSlots.find (PeekPointer (blePhy)) != m_gridSlots.end ())
+        {
+          RemoveFromGrid (PeekPointer (blePhy));
+          RemoveMobilityPhy (PeekPointer (blePhy));
+        }
+      }
+      else
+      {
+        m_otherPhys.erase (
+            std::find (m_otherPhys.begin (), m_otherPhys.end (), phy));
+      }
+    }
+
+  void
+    BleSpectrumChannel::Retune (Ptr<BlePhy> phy)
+    {
+      NS_LOG_FUNCTION (this << phy);
+      std::unordered_map<const BlePhy *, std::pair<uint8_t, std::size_t> >
+        ::iterator slot = m_slots.find (PeekPointer (phy));
+      if (slot == m_slots.end ())
+      {
+        return;
+      }
+      uint8_t channelIndex = phy->GetChannelIndex ();
+      NS_ASSERT (channelIndex < NB_BANDS);
+      if (slot->second.first == channelIndex)
+      {
+        return;
+      }
+      RemoveFromBucket (PeekPointer (phy));
+      slot->second =
+        std::make_pair (channelIndex, m_buckets[channelIndex].size ());
+      m_buckets[channelIndex].push_back (phy);
+    }
+
+  void
+    BleSpectrumChannel::RemoveFromBucket (const BlePhy *phy)
+    {
+      std::pair<uint8_t, std::size_t> slot = m_slots[phy];
+      std::vector<Ptr<BlePhy> > &bucket = m_buckets[slot.first];
+      NS_ASSERT (PeekPointer (bucket[slot.second]) == phy);
+      if (slot.second + 1 != bucket.size ())
+      {
+        bucket[slot.second] = bucket.back ();
+        m_slots[PeekPointer (bucket[slot.second])].second = slot.second;
+      }
+      bucket.pop_back ();
+    }
+
+  std::size_t
+    BleSpectrumChannel::GetNDevices (void) const
+    {
+      return m_phyList.size ();
+    }
+
+  Ptr<NetDevice>
+    BleSpectrumChannel::GetDevice (std::size_t i) const
+    {
+      NS_ASSERT (i < m_phyList.size ());
+      return m_phyList.at (i)->GetDevice ();
+    }
+
+  void
+    BleSpectrumChannel::StartTx (Ptr<SpectrumSignalParameters> txParams)
+    {
+      NS_LOG_FUNCTION (this << txParams->psd << txParams->duration
+          << txParams->txPhy);
+      NS_ASSERT_MSG (txParams->psd, "NULL txPsd");
+      NS_ASSERT_MSG (txParams->txPhy, "NULL txPhy");
+
+      // copy it since traced value cannot be const
+      m_txSigParamsTrace (txParams->Copy ());
+      CheckPropagationModels ();
+
+      Ptr<BleSpectrumSignalParameters> bleParams =
+        DynamicCast<BleSpectrumSignalParameters> (txParams);
+      if (!bleParams)
+      {
+        // Unknown signal, it may cover any channel
+        for (auto &phy : m_phyList)
+        {
+          Deliver (txParams, phy);
+        }
+        return;
+      }
+
+      if (m_spatialIndex && !m_gridBuilt)
+      {
+        BuildGrid ();
+      }
+      Ptr<MobilityModel> senderMobility = txParams->txPhy->GetMobility ();
+      if (m_cellSize > 0 && senderMobility)
+      {
+        // Everything within reach is in the cells around the sender
+        Vector position = senderMobility->GetPosition ();
+        int64_t cx = (int64_t) std::floor (position.x / m_cellSize);
+        int64_t cy = (int64_t) std::floor (position.y / m_cellSize);
+        for (int64_t x = cx - 1; x <= cx + 1; x++)
+        {
+          for (int64_t y = cy - 1; y <= cy + 1; y++)
+          {
+            std::unordered_map<uint64_t, std::vector<Ptr<BlePhy> > >
+              ::const_iterator cell = m_grid.find (PackCell (x, y));
+            if (cell != m_grid.end ())
+            {
+              DeliverInRange (bleParams, cell->second);
+            }
+          }
+        }
+        DeliverInRange (bleParams, m_unplaced);
+      }
+      else
+      {
+        // A BLE signal only reaches the bands of its channel and the
+        // leakage bands around it
+        int reach = BleSignal::NB_LEAKAGE_BANDS / 2;
+        int first = std::max (0, bleParams->GetChannel () - reach);
+        int last = std::min (NB_BANDS - 1, bleParams->GetChannel () + reach);
+        for (int channelIndex = first; channelIndex <= last; channelIndex++)
+        {
+          for (auto &phy : m_buckets[channelIndex])
+          {
+            Deliver (txParams, phy);
+          }
+        }
+      }
+      for (auto &phy : m_otherPhys)
+      {
+        Deliver (txParams, phy);
+      }
+    }
+
+  void
+    BleSpectrumChannel::DeliverInRange (
+        Ptr<BleSpectrumSignalParameters> txParams,
+        const std::vector<Ptr<BlePhy> > &phys)
+    {
+      int reach = BleSignal::NB_LEAKAGE_BANDS / 2;
+      for (auto &phy : phys)
+      {
+        if (std::abs (phy->GetChannelIndex () - txParams->GetChannel ())
+            <= reach)
+        {
+          Deliver (txParams, phy);
+        }
+      }
+    }
+
+  void
+    BleSpectrumChannel::Deliver (Ptr<SpectrumSignalParameters> txParams,
+        Ptr<SpectrumPhy> receiver)
+    {
+      if (receiver == txParams->txPhy)
+      {
+        return;
+      }
+
+      Ptr<NetDevice> rxNetDevice = receiver->GetDevice ();
+      Ptr<NetDevice> txNetDevice = txParams->txPhy->GetDevice ();
+      if (rxNetDevice && txNetDevice
+          && rxNetDevice->GetNode ()->GetId ()
+          == txNetDevice->GetNode ()->GetId ())
+      {
+        // no path loss model supports antennas of the same node
+        return;
+      }
+
+      if (m_filter && m_filter->Filter (txParams, receiver))
+      {
+        return;
+      }
+
+      Time delay = MicroSeconds (0);
+      double pathLossDb = 0;
+      Ptr<MobilityModel> senderMobility = txParams->txPhy->GetMobility ();
+      Ptr<MobilityModel> receiverMobility = receiver->GetMobility ();
+
+      if (senderMobility && receiverMobility)
+      {
+        Vector txVelocity = senderMobility->GetVelocity ();
+        Vector rxVelocity = receiverMobility->GetVelocity ();
+        if (m_cachePathLoss && m_deterministicLoss
+            && txVelocity.x == 0 && txVelocity.y == 0 && txVelocity.z == 0
+            && rxVelocity.x == 0 && rxVelocity.y == 0 && rxVelocity.z == 0)
+        {
+          PhyPair key (PeekPointer (txParams->txPhy), PeekPointer (receiver));
+          std::unordered_map<PhyPair, PathLossEntry, PhyPairHash>::iterator
+            cached = m_pathLossCache.find (key);
+          if (cached == m_pathLossCache.end ())
+          {
+            if (m_pathLossCache.size () >= m_maxCachedPathLosses)
+            {
+              NS_LOG_LOGIC ("Path loss cache full, emptying it");
+              m_pathLossCache.clear ();
+              m_cachedPairs.clear ();
+            }
+            TrackMobility (senderMobility);
+            TrackMobility (receiverMobility);
+            cached = m_pathLossCache.emplace (key, PathLossEntry ()).first;
+            CalcPathLoss (txParams, receiver, cached->second.pathLossDb,
+                cached->second.delay);
+            cached->second.txMobility = PeekPointer (senderMobility);
+            cached->second.rxMobility = PeekPointer (receiverMobility);
+            m_cachedPairs[PeekPointer (senderMobility)].insert (key);
+            m_cachedPairs[PeekPointer (receiverMobility)].insert (key);
+          }
+          pathLossDb = cached->second.pathLossDb;
+          delay = cached->second.delay;
+        }
+        else
+        {
+          CalcPathLoss (txParams, receiver, pathLossDb, delay);
+        }
+        m_pathLossTrace (txParams->txPhy, receiver, pathLossDb);
+        if (pathLossDb > m_maxLossDb)
+        {
+          // beyond range
+          return;
+        }
+      }
+
+      NS_LOG_LOGIC ("copying signal parameters " << txParams);
+      Ptr<SpectrumSignalParameters> rxParams = txParams->Copy ();
+      if (senderMobility && receiverMobility)
+      {
+        *(rxParams->psd) *= std::pow (10.0, (-pathLossDb) / 10.0);
+        if (m_spectrumPropagationLoss)
+        {
+          rxParams->psd = m_spectrumPropagationLoss
+            ->CalcRxPowerSpectralDensity (rxParams, senderMobility,
+                receiverMobility);
+        }
+      }
+
+      if (rxNetDevice)
+      {
+        // the receiver has a NetDevice, so it is attached to a Node
+        Simulator::ScheduleWithContext (rxNetDevice->GetNode ()->GetId (),
+            delay, &BleSpectrumChannel::StartRx, rxParams, receiver);
+      }
+      else
+      {
+        Simulator::Schedule (delay, &BleSpectrumChannel::StartRx,
+            rxParams, receiver);
+      }
+    }
+
+  void
+    BleSpectrumChannel::CalcPathLoss (Ptr<SpectrumSignalParameters> txParams,
+        Ptr<SpectrumPhy> receiver, double &pathLossDb, Time &delay) const
+    {
+      Ptr<MobilityModel> senderMobility = txParams->txPhy->GetMobility ();
+      Ptr<MobilityModel> receiverMobility = receiver->GetMobility ();
+      pathLossDb = 0;
+      if (txParams->txAntenna)
+      {
+        Angles txAngles (receiverMobility->GetPosition (),
+            senderMobility->GetPosition ());
+        pathLossDb -= txParams->txAntenna->GetGainDb (txAngles);
+      }
+      Ptr<AntennaModel> rxAntenna =
+        DynamicCast<AntennaModel> (receiver->GetAntenna ());
+      if (rxAntenna)
+      {
+        Angles rxAngles (senderMobility->GetPosition (),
+            receiverMobility->GetPosition ());
+        pathLossDb -= rxAntenna->GetGainDb (rxAngles);
+      }
+      if (m_propagationLoss)
+      {
+        pathLossDb -= m_propagationLoss->CalcRxPower (0, senderMobility,
+            receiverMobility);
+      }
+      delay = MicroSeconds (0);
+      if (m_propagationDelay)
+      {
+        delay = m_propagationDelay->GetDelay (senderMobility,
+            receiverMobility);
+      }
+    }
+
+  void
+    BleSpectrumChannel::TrackMobility (Ptr<MobilityModel> mobility)
+    {
+      if (!m_tracked.insert (PeekPointer (mobility)).second)
+      {
+        return;
+      }
+      mobility->TraceConnectWithoutContext ("CourseChange",
+          MakeCallback (&BleSpectrumChannel::CourseChanged, this));
+      m_trackedMobility.push_back (mobility);
+    }
+
+  void
+    BleSpectrumChannel::ForgetPathLosses (const MobilityModel *mobility)
+    {
+      std::unordered_map<const MobilityModel *,
+        std::unordered_set<PhyPair, PhyPairHash> >::iterator pairs =
+          m_cachedPairs.find (mobility);
+      if (pairs == m_cachedPairs.end ())
+      {
+        return;
+      }
+      for (auto &key : pairs->second)
+      {
+        std::unordered_map<PhyPair, PathLossEntry, PhyPairHash>::iterator
+          cached = m_pathLossCache.find (key);
+        NS_ASSERT (cached != m_pathLossCache.end ());
+        // The pair is also listed under the mobility model of the other end
+        const MobilityModel *other = cached->second.txMobility == mobility
+          ? cached->second.rxMobility : cached->second.txMobility;
+        if (other != mobility)
+        {
+          std::unordered_map<const MobilityModel *,
+            std::unordered_set<PhyPair, PhyPairHash> >::iterator otherPairs =
+              m_cachedPairs.find (other);
+          NS_ASSERT (otherPairs != m_cachedPairs.end ());
+          otherPairs->second.erase (key);
+          if (otherPairs->second.empty ())
+          {
+            m_cachedPairs.erase (otherPairs);
+          }
+        }
+        m_pathLossCache.erase (cached);
+      }
+      m_cachedPairs.erase (pairs);
+    }
+
+  std::size_t
+    BleSpectrumChannel::GetNCachedPathLosses (void) const
+    {
+      return m_pathLossCache.size ();
+    }
+
+  std::size_t
+    BleSpectrumChannel::GetNCachedPairEntries (void) const
+    {
+      std::size_t entries = 0;
+      for (auto &pairs : m_cachedPairs)
+      {
+        entries += pairs.second.size ();
+      }
+      return entries;
+    }
+
+  void
+    BleSpectrumChannel::CheckPropagationModels (void)
+    {
+      if (m_propagationLoss == m_checkedLoss
+          && m_propagationDelay == m_checkedDelay)
+      {
+        return;
+      }
+      NS_LOG_FUNCTION (this);
+      m_checkedLoss = m_propagationLoss;
+      m_checkedDelay = m_propagationDelay;
+      m_pathLossCache.clear ();
+      m_cachedPairs.clear ();
+      m_deterministicLoss = IsDeterministic (m_propagationLoss);
+      if (m_gridBuilt)
+      {
+        // The reach depends on the loss model
+        ResetGrid ();
+      }
+      if (m_cachePathLoss && !m_deterministicLoss)
+      {
+        NS_LOG_WARN ("The propagation loss model may be random, "
+            "path losses are not cached");
+      }
+    }
+
+  bool
+    BleSpectrumChannel::IsDeterministic (Ptr<PropagationLossModel> model)
+    {
+      static const char *deterministic[] = {
+        "ns3::FriisPropagationLossModel",
+        "ns3::TwoRayGroundPropagationLossModel",
+        "ns3::LogDistancePropagationLossModel",
+        "ns3::ThreeLogDistancePropagationLossModel",
+        "ns3::FixedRssLossModel",
+        "ns3::MatrixPropagationLossModel",
+        "ns3::RangePropagationLossModel",
+        "ns3::OkumuraHataPropagationLossModel",
+        "ns3::Cost231PropagationLossModel",
+        "ns3::ItuR1411LosPropagationLossModel",
+        "ns3::ItuR1411NlosOverRooftopPropagationLossModel",
+        "ns3::Kun2600MhzPropagationLossModel",
+      };
+      for (; model; model = model->GetNext ())
+      {
+        std::string name = model->GetInstanceTypeId ().GetName ();
+        if (std::find (std::begin (deterministic), std::end (deterministic),
+              name) == std::end (deterministic))
+        {
+          NS_LOG_LOGIC ("Not known to be deterministic: " << name);
+          return false;
+        }
+      }
+      return true;
+    }
+
+  void
+    BleSpectrumChannel::CourseChanged (Ptr<const MobilityModel> mobility)
+    {
+      NS_LOG_FUNCTION (this << mobility);
+      ForgetPathLosses (PeekPointer (mobility));
+
+      std::unordered_map<const MobilityModel *, std::vector<Ptr<BlePhy> > >
+        ::iterator phys = m_mobilityPhys.find (PeekPointer (mobility));
+      if (phys != m_mobilityPhys.end ())
+      {
+        for (auto &phy : phys->second)
+        {
+          RemoveFromGrid (PeekPointer (phy));
+          AddToGrid (phy);
+        }
+      }
+    }
+
+  double
+    BleSpectrumChannel::CalcReach (void) const
+    {
+      NS_LOG_FUNCTION (this);
+      if (!m_propagationLoss)
+      {
+        return 0;
+      }
+      Ptr<ConstantPositionMobilityModel> a =
+        CreateObject<ConstantPositionMobilityModel> ();
+      Ptr<ConstantPositionMobilityModel> b =
+        CreateObject<ConstantPositionMobilityModel> ();
+      a->SetPosition (Vector (0, 0, 0));
+
+      double inside = 0;
+      double outside = 1;
+      while (true)
+      {
+        b->SetPosition (Vector (outside, 0, 0));
+        if (m_propagationLoss->CalcRxPower (m_maxTxPower, a, b)
+            < m_reachThreshold)
+        {
+          break;
+        }
+        inside = outside;
+        outside *= 2;
+        if (outside > 1e7)
+        {
+          NS_LOG_WARN ("No bounded reach, spatial index disabled");
+          return 0;
+        }
+      }
+      while (outside - inside > 0.01 * outside)
+      {
+        double middle = (inside + outside) / 2;
+        b->SetPosition (Vector (middle, 0, 0));
+        if (m_propagationLoss->CalcRxPower (m_maxTxPower, a, b)
+            < m_reachThreshold)
+        {
+          outside = middle;
+        }
+        else
+        {
+          inside = middle;
+        }
+      }
+      return outside;
+    }
+
+  void
+    BleSpectrumChannel::BuildGrid (void)
+    {
+      NS_LOG_FUNCTION (this);
+      m_gridBuilt = true;
+      if (!m_deterministicLoss)
+      {
+        NS_LOG_WARN ("The propagation loss model may be random, "
+            "spatial index disabled");
+        m_cellSize = 0;
+        return;
+      }
+      m_cellSize = CalcReach ();
+      NS_LOG_INFO ("Spatial grid cell size: " << m_cellSize << " m");
+      if (m_cellSize <= 0)
+      {
+        return;
+      }
+      for (auto &phy : m_phyList)
+      {
+        Ptr<BlePhy> blePhy = DynamicCast<BlePhy> (phy);
+        if (!blePhy)
+        {
+          continue;
+        }
+        Ptr<MobilityModel> mobility = blePhy->GetMobility ();
+        if (mobility)
+        {
+          // makes sure course changes are followed
+          TrackMobility (mobility);
+          AddMobilityPhy (blePhy, mobility);
+        }
+        AddToGrid (blePhy);
+      }
+    }
+
+  void
+    BleSpectrumChannel::ResetGrid (void)
+    {
+      NS_LOG_FUNCTION (this);
+      m_gridBuilt = false;
+      m_cellSize = 0;
+      m_grid.clear ();
+      m_unplaced.clear ();
+      m_gridSlots.clear ();
+      m_mobilityPhys.clear ();
+      m_mobilitySlots.clear ();
+    }
+
+  void
+    BleSpectrumChannel::AddMobilityPhy (Ptr<BlePhy> phy,
+        Ptr<MobilityModel> mobility)
+    {
+      std::vector<Ptr<BlePhy> > &phys = m_mobilityPhys[PeekPointer (mobility)];
+      m_mobilitySlots[PeekPointer (phy)] =
+        std::make_pair (PeekPointer (mobility), phys.size ());
+      phys.push_back (phy);
+    }
+
+  void
+    BleSpectrumChannel::RemoveMobilityPhy (const BlePhy *phy)
+    {
+      std::unordered_map<const BlePhy *,
+        std::pair<const MobilityModel *, std::size_t> >::iterator it =
+          m_mobilitySlots.find (phy);
+      if (it == m_mobilitySlots.end ())
+      {
+        return;
+      }
+      std::pair<const MobilityModel *, std::size_t> slot = it->second;
+      m_mobilitySlots.erase (it);
+      std::vector<Ptr<BlePhy> > &phys = m_mobilityPhys[slot.first];
+      NS_ASSERT (PeekPointer (phys[slot.second]) == phy);
+      if (slot.second + 1 != phys.size ())
+      {
+        phys[slot.second] = phys.back ();
+        m_mobilitySlots[PeekPointer (phys[slot.second])].second = slot.second;
+      }
+      phys.pop_back ();
+      if (phys.empty ())
+      {
+        m_mobilityPhys.erase (slot.first);
+      }
+    }
+
+  uint64_t
+    BleSpectrumChannel::GetCell (const Vector &position) const
+    {
+      return PackCell ((int64_t) std::floor (position.x / m_cellSize),
+          (int64_t) std::floor (position.y / m_cellSize));
+    }
+
+  void
+    BleSpectrumChannel::AddToGrid (Ptr<BlePhy> phy)
+    {
+      GridSlot slot;
+      Ptr<MobilityModel> mobility = phy->GetMobility ();
+      Vector velocity;
+      if (mobility)
+      {
+        velocity = mobility->GetVelocity ();
+      }
+      std::vector<Ptr<BlePhy> > *phys = &m_unplaced;
+      slot.placed = mobility
+        && velocity.x == 0 && velocity.y == 0 && velocity.z == 0;
+      slot.cell = 0;
+      if (slot.placed)
+      {
+        slot.cell = GetCell (mobility->GetPosition ());
+        phys = &m_grid[slot.cell];
+      }
+      slot.position = phys->size ();
+      phys->push_back (phy);
+      m_gridSlots[PeekPointer (phy)] = slot;
+    }
+
+  void
+    BleSpectrumChannel::RemoveFromGrid (const BlePhy *phy)
+    {
+      std::unordered_map<const BlePhy *, GridSlot>::iterator it =
+        m_gridSlots.find (phy);
+      NS_ASSERT (it != m_gridSlots.end ());
+      GridSlot slot = it->second;
+      m_gridSlots.erase (it);
+      std::vector<Ptr<BlePhy> > &phys =
+        slot.placed ? m_grid[slot.cell] : m_unplaced;
+      NS_ASSERT (PeekPointer (phys[slot.position]) == phy);
+      if (slot.position + 1 != phys.size ())
+      {
+        phys[slot.position] = phys.back ();
+        m_gridSlots[PeekPointer (phys[slot.position])].position =
+          slot.position;
+      }
+      phys.pop_back ();
+      if (slot.placed && phys.empty ())
+      {
+        m_grid.erase (slot.cell);
+      }
+    }
+
+  void
+    BleSpectrumChannel::StartRx (Ptr<SpectrumSignalParameters> params,
+        Ptr<SpectrumPhy> receiver)
+    {
+      NS_LOG_FUNCTION (params);
+      receiver->StartRx (params);
+    }
+
+} // namespace ns3
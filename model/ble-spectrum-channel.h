@@ -0,0 +1,323 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * Copyright (c) 2018 KULeuven
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+#ifndef BLE_SPECTRUM_CHANNEL_H
+#define BLE_SPECTRUM_CHANNEL_H
+
+#include <ns3/spectrum-channel.h>
+#include <ns3/spectrum-phy.h>
+#include <ns3/ptr.h>
+#include <ns3/nstime.h>
+#include <ns3/vector.h>
+#include "ble-phy.h"
+#include "ble-spectrum-signal-parameters.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace ns3 {
+
+class MobilityModel;
+class PropagationLossModel;
+class PropagationDelayModel;
+
+/**
+ * \ingroup ble
+ * \brief SpectrumChannel shared by all BLE devices, on all 40 RF channels
+ *
+ * Receivers are kept in one registry, bucketed by the channel index their
+ * BlePhy is tuned to. A BLE transmission is only delivered to the PHYs
+ * tuned to its channel or to a channel close enough to be hit by its
+ * leakage (see BleSignal). Non-BLE PHYs and non-BLE transmissions are
+ * handled as in SingleModelSpectrumChannel. A BlePhy calls Retune when it
+ * hops, which moves it between buckets in constant time.
+ *
+ * Optionally (attribute CachePathLoss), the path loss and propagation delay
+ * between two PHYs are computed once and reused until the mobility model of
+ * one of them fires its CourseChange trace. Pairs in which a PHY moves are
+ * never cached, and at most MaxCachedPathLosses pairs are kept. Caching is
+ * only valid for deterministic propagation loss models: with a random model
+ * (e.g. Nakagami fading) the first draw would be reused for every packet.
+ * It is therefore suspended while the loss model chain holds a model that
+ * is not known to be deterministic. The cache is emptied whenever a loss or
+ * delay model is added to the channel.
+ *
+ * Optionally (attribute SpatialIndex), static BlePhys are also kept in a
+ * uniform grid. The cell size is the distance at which a signal sent at
+ * MaxTxPower drops below ReachThreshold according to the propagation loss
+ * model, so a BLE transmission is only offered to the PHYs in the 3x3 cells
+ * around the sender. Moving PHYs, and PHYs without a mobility model, are
+ * always offered every signal. Antenna gains are not part of the reach, and
+ * the same restriction to deterministic loss models applies: the grid is
+ * not used while the loss model chain holds a model that is not known to be
+ * deterministic, and it is rebuilt with a new reach when a loss model is
+ * added to the channel.
+ */
+class BleSpectrumChannel : public SpectrumChannel
+{
+public:
+  BleSpectrumChannel ();
+  ~BleSpectrumChannel ();
+
+  static TypeId GetTypeId (void);
+
+  // inherited from SpectrumChannel
+  void AddRx (Ptr<SpectrumPhy> phy) override;
+  void RemoveRx (Ptr<SpectrumPhy> phy) override;
+  void StartTx (Ptr<SpectrumSignalParameters> params) override;
+
+  // inherited from Channel
+  std::size_t GetNDevices (void) const override;
+  Ptr<NetDevice> GetDevice (std::size_t i) const override;
+
+  /**
+   * Move a registered BlePhy to the bucket of its current channel index.
+   *
+   * \param phy the PHY that changed its channel index
+   */
+  void Retune (Ptr<BlePhy> phy);
+
+  /**
+   * \return the number of pairs of PHYs whose path loss is cached
+   */
+  std::size_t GetNCachedPathLosses (void) const;
+
+  /**
+   * Every cached pair is listed under the mobility models of both its PHYs,
+   * so this is twice GetNCachedPathLosses, unless both PHYs share a model.
+   *
+   * \return the number of entries in the per mobility model lists of pairs
+   */
+  std::size_t GetNCachedPairEntries (void) const;
+
+protected:
+  void DoDispose (void) override;
+
+private:
+  /**
+   * Compute the received signal and schedule its reception at one PHY.
+   *
+   * \param txParams the transmitted signal
+   * \param receiver the receiving PHY
+   */
+  void Deliver (Ptr<SpectrumSignalParameters> txParams,
+                Ptr<SpectrumPhy> receiver);
+
+  /**
+   * Compute the path loss between a transmitter and a receiver, including
+   * the antenna gains, and the propagation delay.
+   *
+   * \param txParams the transmitted signal
+   * \param receiver the receiving PHY
+   * \param pathLossDb the path loss (dB)
+   * \param delay the propagation delay
+   */
+  void CalcPathLoss (Ptr<SpectrumSignalParameters> txParams,
+                     Ptr<SpectrumPhy> receiver,
+                     double &pathLossDb, Time &delay) const;
+
+  /**
+   * Follow the CourseChange trace of a mobility model, if not done yet.
+   *
+   * \param mobility the mobility model
+   */
+  void TrackMobility (Ptr<MobilityModel> mobility);
+
+  /**
+   * Invalidate the cached path losses of a node that changed course.
+   *
+   * \param mobility the mobility model that changed course
+   */
+  void CourseChanged (Ptr<const MobilityModel> mobility);
+
+  /**
+   * Drop the cached path losses of all pairs a mobility model is part of.
+   *
+   * \param mobility the mobility model
+   */
+  void ForgetPathLosses (const MobilityModel *mobility);
+
+  /**
+   * Notice a change of the propagation loss or delay model since the last
+   * transmission, and drop everything that was derived from the old one.
+   */
+  void CheckPropagationModels (void);
+
+  /**
+   * \param model the first model of a propagation loss chain
+   * \return whether every model in the chain is known to be deterministic
+   */
+  static bool IsDeterministic (Ptr<PropagationLossModel> model);
+
+  /**
+   * Find the distance beyond which a signal sent at MaxTxPower is received
+   * below ReachThreshold, by bisection on the propagation loss model.
+   *
+   * \return the reach (m), or 0 if it is unbounded
+   */
+  double CalcReach (void) const;
+
+  /**
+   * Build the spatial grid from all registered BlePhys.
+   */
+  void BuildGrid (void);
+
+  /**
+   * \param position a position
+   * \return the key of the grid cell holding that position
+   */
+  uint64_t GetCell (const Vector &position) const;
+
+  /**
+   * Put a BlePhy in the grid cell of its position, or in the list of
+   * unplaced PHYs if it has no mobility model or is moving.
+   *
+   * \param phy the PHY
+   */
+  void AddToGrid (Ptr<BlePhy> phy);
+
+  /**
+   * Remember which mobility model moves a BlePhy of the grid.
+   *
+   * \param phy the PHY
+   * \param mobility its mobility model
+   */
+  void AddMobilityPhy (Ptr<BlePhy> phy, Ptr<MobilityModel> mobility);
+
+  /**
+   * Forget the mobility model of a BlePhy, filling the hole with the last
+   * entry.
+   *
+   * \param phy the PHY
+   */
+  void RemoveMobilityPhy (const BlePhy *phy);
+
+  /**
+   * Drop the spatial grid, so it is built again at the next transmission.
+   */
+  void ResetGrid (void);
+
+  /**
+   * Remove a BlePhy from the grid, filling the hole with the last entry.
+   *
+   * \param phy the PHY
+   */
+  void RemoveFromGrid (const BlePhy *phy);
+
+  /**
+   * Offer a BLE signal to the PHYs in a list that are tuned within its
+   * leakage range.
+   *
+   * \param txParams the transmitted signal
+   * \param phys the candidate receivers
+   */
+  void DeliverInRange (Ptr<BleSpectrumSignalParameters> txParams,
+                       const std::vector<Ptr<BlePhy> > &phys);
+
+  /**
+   * Hand a signal to a receiver once it has propagated.
+   *
+   * \param params the received signal
+   * \param receiver the receiving PHY
+   */
+  static void StartRx (Ptr<SpectrumSignalParameters> params,
+                       Ptr<SpectrumPhy> receiver);
+
+  /**
+   * Remove a BlePhy from its bucket, filling the hole with the last entry.
+   *
+   * \param phy the PHY to remove
+   */
+  void RemoveFromBucket (const BlePhy *phy);
+
+  std::vector<Ptr<SpectrumPhy> > m_phyList; //!< all receivers, in order added
+  std::vector<Ptr<BlePhy> > m_buckets[NB_BANDS]; //!< BlePhys per channel index
+  std::unordered_map<const BlePhy *, std::pair<uint8_t, std::size_t> > m_slots;
+        //!< bucket and position of every registered BlePhy
+  std::vector<Ptr<SpectrumPhy> > m_otherPhys; //!< receivers that are no BlePhy
+
+  /**
+   * Cached path loss between a transmitting and a receiving PHY
+   */
+  struct PathLossEntry
+  {
+    double pathLossDb; //!< path loss including antenna gains (dB)
+    Time delay; //!< propagation delay
+    const MobilityModel *txMobility; //!< mobility model of the sender
+    const MobilityModel *rxMobility; //!< mobility model of the receiver
+  };
+  typedef std::pair<const SpectrumPhy *, const SpectrumPhy *> PhyPair;
+        //!< transmitting and receiving PHY
+  /**
+   * Hash of a PhyPair
+   */
+  struct PhyPairHash
+  {
+    std::size_t operator() (const PhyPair &pair) const
+    {
+      std::size_t h = std::hash<const SpectrumPhy *> () (pair.first);
+      return h ^ (std::hash<const SpectrumPhy *> () (pair.second)
+                  + 0x9e3779b9 + (h << 6) + (h >> 2));
+    }
+  };
+  bool m_cachePathLoss; //!< whether path losses are cached
+  uint32_t m_maxCachedPathLosses; //!< cache size at which it is emptied
+  std::unordered_map<PhyPair, PathLossEntry, PhyPairHash> m_pathLossCache;
+        //!< path loss per pair of PHYs
+  std::unordered_map<const MobilityModel *,
+                     std::unordered_set<PhyPair, PhyPairHash> >
+    m_cachedPairs; //!< cached pairs per mobility model of either PHY
+  std::unordered_set<const MobilityModel *> m_tracked;
+        //!< mobility models whose CourseChange trace is connected
+  std::vector<Ptr<MobilityModel> > m_trackedMobility;
+        //!< the same, to disconnect them
+  Ptr<PropagationLossModel> m_checkedLoss; //!< loss model the cache is for
+  Ptr<PropagationDelayModel> m_checkedDelay; //!< delay model the cache is for
+  bool m_deterministicLoss; //!< whether m_checkedLoss is deterministic
+
+  /**
+   * Place of a BlePhy in the spatial grid
+   */
+  struct GridSlot
+  {
+    bool placed; //!< whether the PHY is in a cell, or in m_unplaced
+    uint64_t cell; //!< the cell, if placed
+    std::size_t position; //!< index in the cell or in m_unplaced
+  };
+  bool m_spatialIndex; //!< whether the spatial grid is used
+  double m_maxTxPower; //!< highest transmit power (dBm) for the reach
+  double m_reachThreshold; //!< lowest useful received power (dBm)
+  bool m_gridBuilt; //!< whether BuildGrid ran
+  double m_cellSize; //!< grid cell size (m), 0 if the grid is not usable
+  std::unordered_map<uint64_t, std::vector<Ptr<BlePhy> > > m_grid;
+        //!< static BlePhys per grid cell
+  std::vector<Ptr<BlePhy> > m_unplaced; //!< BlePhys that are not in a cell
+  std::unordered_map<const BlePhy *, GridSlot> m_gridSlots;
+        //!< grid place of every registered BlePhy
+  std::unordered_map<const MobilityModel *, std::vector<Ptr<BlePhy> > >
+    m_mobilityPhys; //!< BlePhys in the grid per mobility model
+  std::unordered_map<const BlePhy *, std::pair<const MobilityModel *,
+                                               std::size_t> >
+    m_mobilitySlots; //!< mobility model and index in m_mobilityPhys per PHY
+};
+
+} // namespace ns3
+
+#endif /* BLE_SPECTRUM_CHANNEL_H */
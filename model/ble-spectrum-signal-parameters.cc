@@ -34,16 +34,22 @@ namespace ns3 {
 NS_LOG_COMPONENT_DEFINE ("BleSpectrumSignalParameters");
 
 BleSpectrumSignalParameters::BleSpectrumSignalParameters (void)
+  : m_accessAddress (0),
+    m_rxPower (0),
+    m_inChannelPower (0)
 {
   NS_LOG_FUNCTION (this);
 }
 
 BleSpectrumSignalParameters::BleSpectrumSignalParameters (
     const BleSpectrumSignalParameters& p)
-  : SpectrumSignalParameters (p)
+  : SpectrumSignalParameters (p),
+    m_accessAddress (p.m_accessAddress),
+    m_rxPower (0),
+    m_inChannelPower (0)
 {
   NS_LOG_FUNCTION (this << &p);
-  packet = p.packet->Copy ();
+  packet = p.packet;
   m_channel = p.m_channel;
 }
 
@@ -78,6 +84,18 @@ BleSpectrumSignalParameters::SetChannel (uint8_t channel)
   m_channel = channel;
 }
 
+void
+BleSpectrumSignalParameters::SetAccessAddress (uint32_t accessAddress)
+{
+  m_accessAddress = accessAddress;
+}
+
+uint32_t
+BleSpectrumSignalParameters::GetAccessAddress (void) const
+{
+  return m_accessAddress;
+}
+
 void
 BleSpectrumSignalParameters::SetBer (double ber)
 {
@@ -101,4 +119,53 @@ BleSpectrumSignalParameters::GetEvent (void)
 {
   return m_event;
 }
+
+void
+BleSpectrumSignalParameters::SetRxPower (double rxPower, double inChannelPower)
+{
+  m_rxPower = rxPower;
+  m_inChannelPower = inChannelPower;
+}
+
+double
+BleSpectrumSignalParameters::GetRxPower (void) const
+{
+  return m_rxPower;
+}
+
+double
+BleSpectrumSignalParameters::GetInChannelPower (void) const
+{
+  return m_inChannelPower;
+}
+
+void
+BleSpectrumSignalParameters::AddSegment (Time start, double power, bool tuned)
+{
+  if (!m_segments.empty ())
+    {
+      Segment &last = m_segments.back ();
+      if (last.power == power && last.tuned == tuned)
+        {
+          return;
+        }
+      if (last.start == start)
+        {
+          last.power = power;
+          last.tuned = tuned;
+          return;
+        }
+    }
+  Segment segment;
+  segment.start = start;
+  segment.power = power;
+  segment.tuned = tuned;
+  m_segments.push_back (segment);
+}
+
+const std::vector<BleSpectrumSignalParameters::Segment> &
+BleSpectrumSignalParameters::GetSegments (void) const
+{
+  return m_segments;
+}
 } // namespace ns3
@@ -29,6 +29,8 @@
 #include <ns3/spectrum-signal-parameters.h>
 #include <ns3/packet.h>
 #include <ns3/event-id.h>
+#include <ns3/nstime.h>
+#include <vector>
 namespace ns3 {
 
 
@@ -52,12 +54,20 @@ struct BleSpectrumSignalParameters : public SpectrumSignalParameters
    */
   BleSpectrumSignalParameters (const BleSpectrumSignalParameters& p);
   /**
-   * The packet burst being transmitted with this signal
+   * The packet being transmitted with this signal. It is shared by the
+   * copies made for every receiver and must not be modified: a receiver
+   * that delivers it copies it first.
    */
-  Ptr<Packet> packet;
+  Ptr<const Packet> packet;
   uint8_t m_channel;
   void SetChannel (uint8_t channel);
   uint8_t GetChannel (void);
+  /**
+   * The access address of the link the packet belongs to
+   */
+  uint32_t m_accessAddress;
+  void SetAccessAddress (uint32_t accessAddress);
+  uint32_t GetAccessAddress (void) const;
   void SetBer (double ber);
   double GetBer (void);
   double m_ber;
@@ -65,6 +75,40 @@ struct BleSpectrumSignalParameters : public SpectrumSignalParameters
   EventId GetEvent (void);
   void SetEvent (EventId event);  
 
+  /**
+   * Cache the received power of this signal, computed once on arrival.
+   *
+   * \param rxPower total received power (W)
+   * \param inChannelPower received power spectral density (W/Hz) in the
+   *                       centre band of the signal's channel
+   */
+  void SetRxPower (double rxPower, double inChannelPower);
+  double GetRxPower (void) const;
+  double GetInChannelPower (void) const;
+  double m_rxPower; //!< total received power (W), 0 until received
+  double m_inChannelPower; //!< received PSD in the centre band (W/Hz)
+
+  /**
+   * One piece of the piecewise-constant power seen by the receiver while
+   * this signal is being received.
+   */
+  struct Segment
+  {
+    Time start;   //!< time from which this segment holds
+    double power; //!< total power (W/Hz) in the signal's centre band
+    bool tuned;   //!< whether the receiver listens on the signal's channel
+  };
+  /**
+   * Start a new segment, unless nothing changed since the last one.
+   *
+   * \param start time from which the segment holds
+   * \param power total power (W/Hz) in the signal's centre band
+   * \param tuned whether the receiver listens on the signal's channel
+   */
+  void AddSegment (Time start, double power, bool tuned);
+  const std::vector<Segment> & GetSegments (void) const;
+  std::vector<Segment> m_segments;
+
 };
 
 }  // namespace ns3
@@ -42,6 +42,7 @@
 #include <ns3/isotropic-antenna-model.h>
 #include <ns3/trace-helper.h>
 #include <ns3/drop-tail-queue.h>
+#include <map>
 #include <unordered_map>
 #include "ns3/network-module.h"
 #include "ns3/csma-module.h"
@@ -698,6 +699,841 @@ BleTestCase4::DoRun (void)
 
 
 
+// Checks that the anchor allocator never gives two links of one device
+// the same transmit window, and reports when the windows cannot fit
+class BleTestCase5 : public TestCase
+{
+public:
+  BleTestCase5 ();
+  virtual ~BleTestCase5 ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BleTestCase5::BleTestCase5 ()
+  : TestCase ("Ble test case for the anchor point allocator")
+{
+}
+
+BleTestCase5::~BleTestCase5 ()
+{
+}
+
+void
+BleTestCase5::DoRun (void)
+{
+  // Fully connected mesh, as built by BleHelper::CreateAllLinks
+  uint32_t nDevices = 12;
+  BleAnchorAllocator allocator;
+  std::vector<std::pair<uint32_t, uint32_t> > links;
+  for (uint32_t i = 0; i < nDevices; i++)
+    {
+      for (uint32_t j = i+1; j < nDevices; j++)
+        {
+          allocator.AddLink (i, j);
+          links.push_back (std::make_pair (i, j));
+        }
+    }
+  NS_TEST_ASSERT_MSG_EQ (allocator.Allocate (6), true,
+      "A mesh of 12 devices should fit in one connection interval");
+  NS_TEST_ASSERT_MSG_EQ (allocator.GetConnInterval (),
+      allocator.GetNOffsets () * BleAnchorAllocator::SLOTS_PER_WINDOW,
+      "The connection interval should be grown to hold every window");
+
+  for (uint32_t d = 0; d < nDevices; d++)
+    {
+      std::vector<bool> taken (allocator.GetNOffsets (), false);
+      for (uint32_t l = 0; l < links.size (); l++)
+        {
+          if (links[l].first != d && links[l].second != d)
+            {
+              continue;
+            }
+          uint32_t offset = allocator.GetOffset (l);
+          NS_TEST_ASSERT_MSG_EQ (taken[offset], false,
+              "Device " << d << " has two links with offset " << offset);
+          taken[offset] = true;
+        }
+    }
+
+  // A device with more links than windows in the longest interval
+  BleAnchorAllocator star;
+  uint32_t nLeaves = BleAnchorAllocator::MAX_CONN_INTERVAL
+    / BleAnchorAllocator::SLOTS_PER_WINDOW + 1;
+  for (uint32_t i = 1; i <= nLeaves; i++)
+    {
+      star.AddLink (0, i);
+    }
+  NS_TEST_ASSERT_MSG_EQ (star.Allocate (3200), false,
+      "An infeasible schedule should be reported");
+}
+
+// Checks that the bit error counts drawn by the error model follow the
+// binomial distribution, with few and with many errors per run
+class BleTestCase6 : public TestCase
+{
+public:
+  BleTestCase6 ();
+  virtual ~BleTestCase6 ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BleTestCase6::BleTestCase6 ()
+  : TestCase ("Ble test case for the bit error sampler")
+{
+}
+
+BleTestCase6::~BleTestCase6 ()
+{
+}
+
+void
+BleTestCase6::DoRun (void)
+{
+  Ptr<BleErrorModel> errorModel = CreateObject<BleErrorModel> ();
+  Ptr<UniformRandomVariable> random = CreateObject<UniformRandomVariable> ();
+  random->SetStream (1);
+
+  // (ber, bits): geometric walk, and exact binomial draw
+  double bers[2] = {0.002, 0.2};
+  uint32_t bits = 1000;
+  uint32_t samples = 20000;
+  for (double ber : bers)
+    {
+      double sum = 0;
+      double sumSquares = 0;
+      for (uint32_t i = 0; i < samples; i++)
+        {
+          double n = errorModel->GetBitErrors (ber, bits, random);
+          sum += n;
+          sumSquares += n * n;
+        }
+      double mean = sum / samples;
+      double variance = sumSquares / samples - mean * mean;
+      NS_TEST_ASSERT_MSG_EQ_TOL (mean, bits * ber, 0.05 * bits * ber,
+          "Mean number of bit errors is off for ber " << ber);
+      NS_TEST_ASSERT_MSG_EQ_TOL (variance, bits * ber * (1 - ber),
+          0.1 * bits * ber * (1 - ber),
+          "Variance of the number of bit errors is off for ber " << ber);
+    }
+
+  NS_TEST_ASSERT_MSG_EQ (errorModel->GetBitErrors (0, bits, random), 0,
+      "No errors expected at ber 0");
+  NS_TEST_ASSERT_MSG_EQ (errorModel->GetBitErrors (1, bits, random), bits,
+      "Every bit is wrong at ber 1");
+}
+
+// Checks the airtime of empty, typical and maximum size PDUs in every PHY
+// mode, and which of them fit an exchange in a 5 slot transmit window
+class BleTestCase7 : public TestCase
+{
+public:
+  BleTestCase7 ();
+  virtual ~BleTestCase7 ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BleTestCase7::BleTestCase7 ()
+  : TestCase ("Ble test case for the PDU airtime")
+{
+}
+
+BleTestCase7::~BleTestCase7 ()
+{
+}
+
+void
+BleTestCase7::DoRun (void)
+{
+  Ptr<BlePhy> phy = CreateObject<BlePhy> ();
+  uint32_t header = BleMacHeader ().GetSerializedSize ();
+  BlePhy::PhyMode modes[4] = {BlePhy::LE_1M, BlePhy::LE_2M,
+    BlePhy::LE_CODED_S2, BlePhy::LE_CODED_S8};
+  uint32_t payloads[3] = {0, 27, 255};
+  // Expected airtime (us) per mode and payload
+  double expected[4][3] = {
+    {80, 296, 2120},
+    {44, 152, 1064},
+    {462, 894, 4542},
+    {720, 2448, 17040}};
+  Time window = MicroSeconds (5000);
+
+  for (uint32_t m = 0; m < 4; m++)
+    {
+      phy->SetPhyMode (modes[m]);
+      for (uint32_t p = 0; p < 3; p++)
+        {
+          NS_TEST_ASSERT_MSG_EQ_TOL (
+              phy->GetAirtime (header + payloads[p]).GetSeconds (),
+              expected[m][p] * 1e-6, 1e-9,
+              "Wrong airtime for mode " << modes[m] << " and payload "
+              << payloads[p]);
+        }
+      // A maximum size PDU, T_IFS and an empty response
+      Time exchange = phy->GetAirtime (header + 255) + MicroSeconds (T_IFS)
+        + phy->GetAirtime (header);
+      NS_TEST_ASSERT_MSG_EQ ((exchange <= window), (m < 2),
+          "Only the uncoded PHYs fit a maximum size exchange in the window"
+          " for mode " << modes[m]);
+    }
+
+  // The MIC adds 4 bytes
+  phy->SetPhyMode (BlePhy::LE_1M);
+  phy->SetAttribute ("Encrypted", BooleanValue (true));
+  NS_TEST_ASSERT_MSG_EQ_TOL (phy->GetAirtime (header + 27).GetSeconds (),
+      328e-6, 1e-9, "Wrong airtime for an encrypted PDU");
+}
+
+// Checks the interpolated BER table against the erfc curve it is built
+// from, between and on its grid points, with and without coding gain
+class BleTestCase8 : public TestCase
+{
+public:
+  BleTestCase8 ();
+  virtual ~BleTestCase8 ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BleTestCase8::BleTestCase8 ()
+  : TestCase ("Ble test case for the BER table")
+{
+}
+
+BleTestCase8::~BleTestCase8 ()
+{
+}
+
+void
+BleTestCase8::DoRun (void)
+{
+  Ptr<BleErrorModel> errorModel = CreateObject<BleErrorModel> ();
+  uint8_t codings[3] = {1, 2, 8};
+  double gains[3] = {0, 4, 8};
+  for (uint32_t c = 0; c < 3; c++)
+    {
+      // 0.013 dB steps fall between the 0.05 dB grid points
+      for (double snrDb = -30; snrDb <= 30; snrDb += 0.013)
+        {
+          double snr = std::pow (10.0, snrDb / 10);
+          double reference = (double) errorModel->GetBER (
+              std::pow (10.0, (snrDb + gains[c]) / 10));
+          double ber = errorModel->GetBER (snr, codings[c]);
+          // Linear interpolation of the steep tail overestimates a little
+          NS_TEST_ASSERT_MSG_EQ_TOL (ber, reference, 0.01 * reference + 1e-12,
+              "BER table is off at " << snrDb << " dB, coding "
+              << (uint32_t) codings[c]);
+        }
+    }
+
+  // The batch lookup matches the single one
+  double snrDb[4] = {-40, -3, 7.5, 40};
+  double ber[4];
+  errorModel->GetBER (snrDb, ber, 4, 2);
+  for (uint32_t i = 0; i < 4; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ_TOL (ber[i],
+          errorModel->GetBER (std::pow (10.0, snrDb[i] / 10), 2), 1e-15,
+          "Batch BER differs at " << snrDb[i] << " dB");
+    }
+}
+
+// Checks co-channel and adjacent channel rejection with two interferers at
+// once, and that the interferers are forgotten once they have ended
+class BleTestCase9 : public TestCase
+{
+public:
+  BleTestCase9 ();
+  virtual ~BleTestCase9 ();
+
+  void ReceptionEnd (Ptr<Packet> packet, bool error);
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Hand a BLE signal to the receiver, as the channel would.
+   *
+   * \param channel channel index of the signal
+   * \param powerDbm received power (dBm)
+   * \param accessAddress access address of the signal
+   * \param duration airtime of the signal
+   */
+  void Receive (uint8_t channel, double powerDbm, uint32_t accessAddress,
+                Time duration);
+
+  Ptr<BlePhy> m_phy; //!< the receiver
+  std::vector<bool> m_errors; //!< outcome of every reception, in order
+};
+
+BleTestCase9::BleTestCase9 ()
+  : TestCase ("Ble test case for the channel rejection")
+{
+}
+
+BleTestCase9::~BleTestCase9 ()
+{
+}
+
+void
+BleTestCase9::ReceptionEnd (Ptr<Packet> packet, bool error)
+{
+  m_errors.push_back (error);
+}
+
+void
+BleTestCase9::Receive (uint8_t channel, double powerDbm,
+                       uint32_t accessAddress, Time duration)
+{
+  double density = std::pow (10.0, (powerDbm - 30) / 10) / BANDWIDTH;
+  Ptr<SpectrumValue> psd = Create<SpectrumValue> (BlePhy::GetSpectrumModel ());
+  for (int k = 0; k < BleSignal::NB_LEAKAGE_BANDS; k++)
+    {
+      (*psd)[channel + k] = density * BleSignal::LEAKAGE[k];
+    }
+  Ptr<BleSpectrumSignalParameters> params =
+    Create<BleSpectrumSignalParameters> ();
+  params->psd = psd;
+  params->duration = duration;
+  params->packet = Create<Packet> (20);
+  params->SetChannel (channel);
+  params->SetAccessAddress (accessAddress);
+  m_phy->StartRx (params);
+}
+
+void
+BleTestCase9::DoRun (void)
+{
+  uint32_t linkAa = 0x71764129;
+  uint32_t otherAa = 0x12345678;
+  uint8_t wanted = 10;
+  double wantedDbm = -60;
+  m_phy = CreateObject<BlePhy> ();
+  m_phy->SetChannelIndex (wanted);
+  m_phy->SetAccessAddress (linkAa);
+  m_phy->SetReceptionEndCallback (
+      MakeCallback (&BleTestCase9::ReceptionEnd, this));
+
+  // Interferer channels and power relative to the wanted signal (dB).
+  // Co-channel signals need 11 dB C/I, the adjacent channel leaks about
+  // -10 dB into the wanted band, the channels 2 and 3 away -17 and -21 dB.
+  struct Case
+  {
+    uint8_t first;
+    uint8_t second;
+    double relativeDb;
+    bool error;
+  };
+  Case cases[6] = {
+    {10, 10, -15, false}, // co-channel, 12 dB C/I for both together
+    {10, 10, -5, true},   // co-channel, below 11 dB C/I
+    {9, 11, -5, false},   // +-1, rejected by the receive filter
+    {9, 11, 5, true},     // +-1, leakage leaves 2 dB SINR
+    {8, 13, 3, false},    // +2 and +3, 13 dB SINR
+    {8, 13, 30, true}};   // +2 and +3, beyond -27 dB C/I
+
+  for (uint32_t i = 0; i < 6; i++)
+    {
+      Time start = MilliSeconds (10 * i);
+      Simulator::Schedule (start, &BleTestCase9::Receive, this, wanted,
+          wantedDbm, linkAa, MilliSeconds (1));
+      Simulator::Schedule (start + MicroSeconds (100),
+          &BleTestCase9::Receive, this, cases[i].first,
+          wantedDbm + cases[i].relativeDb, otherAa, MicroSeconds (400));
+      Simulator::Schedule (start + MicroSeconds (100),
+          &BleTestCase9::Receive, this, cases[i].second,
+          wantedDbm + cases[i].relativeDb, otherAa, MicroSeconds (400));
+      // Once the interferers ended, nothing is left to disturb a reception
+      Simulator::Schedule (start + MilliSeconds (3), &BleTestCase9::Receive,
+          this, wanted, wantedDbm, linkAa, MilliSeconds (1));
+    }
+  Simulator::Run ();
+  Simulator::Destroy ();
+
+  NS_TEST_ASSERT_MSG_EQ (m_errors.size (), 12, "Every reception should end");
+  for (uint32_t i = 0; i < 6 && m_errors.size () == 12; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (m_errors[2 * i], cases[i].error,
+          "Wrong outcome with interferers on channels "
+          << (uint32_t) cases[i].first << " and "
+          << (uint32_t) cases[i].second << " at "
+          << cases[i].relativeDb << " dB");
+      NS_TEST_ASSERT_MSG_EQ (m_errors[2 * i + 1], false,
+          "Ended interferers still corrupt receptions, case " << i);
+    }
+  m_phy = 0;
+}
+
+// Checks the access address rules one at a time, and that generated access
+// addresses are valid and follow the stream they are drawn from
+class BleTestCase10 : public TestCase
+{
+public:
+  BleTestCase10 ();
+  virtual ~BleTestCase10 ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BleTestCase10::BleTestCase10 ()
+  : TestCase ("Ble test case for the access addresses")
+{
+}
+
+BleTestCase10::~BleTestCase10 ()
+{
+}
+
+void
+BleTestCase10::DoRun (void)
+{
+  // Every address below breaks at most one rule
+  struct Case
+  {
+    uint32_t aa;
+    bool valid;
+    const char *rule;
+  };
+  Case cases[12] = {
+    {0x71764129, true, "spec sample"},
+    {0xEA7B5BF5, true, "run of six equal bits"},
+    {0x9A9A80FD, false, "run of seven equal bits"},
+    {0x5AAD2695, false, "25 transitions"},
+    {0x035EFA25, false, "no transition in the six most significant bits"},
+    {0x97524D6A, false, "12 transitions in the 16 least significant bits"},
+    {0x42650644, false, "two ones in the least significant octet"},
+    {0x71717171, false, "four equal octets"},
+    {BleLink::ADVERTISING_ACCESS_ADDRESS, false, "advertising address"},
+    {0x8E89BED7, false, "one bit from the advertising address"},
+    {0x0E89BED6, false, "one bit from the advertising address"},
+    {0x8E89BED5, true, "two bits from the advertising address"}};
+  for (uint32_t i = 0; i < 12; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ (BleLink::IsValidAccessAddress (cases[i].aa),
+          cases[i].valid, "Wrong validity for 0x" << std::hex << cases[i].aa
+          << " (" << cases[i].rule << ")");
+    }
+
+  // The same stream gives the same valid addresses
+  Ptr<UniformRandomVariable> first = CreateObject<UniformRandomVariable> ();
+  Ptr<UniformRandomVariable> second = CreateObject<UniformRandomVariable> ();
+  first->SetStream (7);
+  second->SetStream (7);
+  Ptr<BleLink> a = CreateObject<BleLink> ();
+  Ptr<BleLink> b = CreateObject<BleLink> ();
+  NS_TEST_ASSERT_MSG_EQ (a->GetAccessAddress (),
+      BleLink::ADVERTISING_ACCESS_ADDRESS,
+      "A new link should use the advertising address");
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      a->GenerateAccessAddress (first);
+      b->GenerateAccessAddress (second);
+      NS_TEST_ASSERT_MSG_EQ (BleLink::IsValidAccessAddress (
+          a->GetAccessAddress ()), true, "Generated an invalid address");
+      NS_TEST_ASSERT_MSG_EQ (a->GetAccessAddress (), b->GetAccessAddress (),
+          "Same stream, different addresses");
+    }
+}
+
+// Checks that every field of the MAC header survives a serialization round
+// trip without touching the others, and the saturation of the length field
+class BleTestCase11 : public TestCase
+{
+public:
+  BleTestCase11 ();
+  virtual ~BleTestCase11 ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BleTestCase11::BleTestCase11 ()
+  : TestCase ("Ble test case for the MAC header")
+{
+}
+
+BleTestCase11::~BleTestCase11 ()
+{
+}
+
+void
+BleTestCase11::DoRun (void)
+{
+  Mac16Address src ("12:34");
+  Mac16Address dest ("AB:CD");
+  uint8_t lengths[3] = {0, 27, 255};
+  for (uint32_t llid = 0; llid < 4; llid++)
+    {
+      for (uint32_t bits = 0; bits < 8; bits++)
+        {
+          for (uint8_t length : lengths)
+            {
+              BleMacHeader header;
+              header.SetSrcAddr (src);
+              header.SetDestAddr (dest);
+              header.SetProtocol (0x86DD);
+              header.SetLLID (llid);
+              header.SetNESN (bits & 1);
+              header.SetSN (bits & 2);
+              header.SetMD (bits & 4);
+              header.SetLength (length);
+
+              Ptr<Packet> packet = Create<Packet> (length);
+              packet->AddHeader (header);
+              NS_TEST_ASSERT_MSG_EQ (packet->GetSize (),
+                  length + header.GetSerializedSize (),
+                  "Serialized header has the wrong size");
+              BleMacHeader copy;
+              packet->RemoveHeader (copy);
+              NS_TEST_ASSERT_MSG_EQ (copy.GetSrcAddr (), src, "Source");
+              NS_TEST_ASSERT_MSG_EQ (copy.GetDestAddr (), dest, "Dest");
+              NS_TEST_ASSERT_MSG_EQ (copy.GetProtocol (), 0x86DD, "Protocol");
+              NS_TEST_ASSERT_MSG_EQ ((uint32_t) copy.GetLLID (), llid, "LLID");
+              NS_TEST_ASSERT_MSG_EQ (copy.GetNESN (), bool (bits & 1), "NESN");
+              NS_TEST_ASSERT_MSG_EQ (copy.GetSN (), bool (bits & 2), "SN");
+              NS_TEST_ASSERT_MSG_EQ (copy.GetMD (), bool (bits & 4), "MD");
+              NS_TEST_ASSERT_MSG_EQ (copy.GetCP (), false, "CP");
+              NS_TEST_ASSERT_MSG_EQ ((uint32_t) copy.GetLength (),
+                  (uint32_t) length, "Length");
+            }
+        }
+    }
+
+  // The 8 bit length field saturates, it does not wrap
+  uint32_t sizes[5] = {0, 27, 255, 256, 1500};
+  uint32_t fields[5] = {0, 27, 255, 255, 255};
+  for (uint32_t i = 0; i < 5; i++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t) BleMacHeader::GetLengthField (sizes[i]),
+          fields[i], "Wrong length field for a payload of " << sizes[i]);
+    }
+
+  NS_TEST_ASSERT_MSG_EQ (BleMacHeader::GetBroadcastAddress (),
+      Mac16Address ("FF:FF"), "Wrong broadcast address");
+  NS_TEST_ASSERT_MSG_EQ (BleMacHeader::GetNullAddress (), Mac16Address (),
+      "Wrong null address");
+}
+
+// Checks that an idle connection is fast forwarded, and that data enqueued
+// at the master ends the fast forward and is delivered
+class BleTestCase12 : public TestCase
+{
+public:
+  BleTestCase12 ();
+  virtual ~BleTestCase12 ();
+
+  void Received (Ptr<const Packet> packet);
+private:
+  virtual void DoRun (void);
+
+  uint32_t m_received; //!< packets received by the slave
+};
+
+BleTestCase12::BleTestCase12 ()
+  : TestCase ("Ble test case for the idle fast forward"),
+    m_received (0)
+{
+}
+
+BleTestCase12::~BleTestCase12 ()
+{
+}
+
+void
+BleTestCase12::Received (Ptr<const Packet> packet)
+{
+  m_received++;
+}
+
+void
+BleTestCase12::DoRun (void)
+{
+  BleHelper helper;
+  NodeContainer nodes;
+  nodes.Create (2);
+  Ptr<SingleModelSpectrumChannel> channel =
+    CreateObject<SingleModelSpectrumChannel> ();
+  channel->AddPropagationLossModel (
+      CreateObject<LogDistancePropagationLossModel> ());
+  channel->SetPropagationDelayModel (
+      CreateObject<ConstantSpeedPropagationDelayModel> ());
+  helper.SetChannel (channel);
+  NetDeviceContainer devices = helper.Install (nodes);
+  Ptr<BleNetDevice> master = DynamicCast<BleNetDevice> (devices.Get (0));
+  Ptr<BleNetDevice> slave = DynamicCast<BleNetDevice> (devices.Get (1));
+  master->SetAddress (Mac16Address ("00:01"));
+  slave->SetAddress (Mac16Address ("00:02"));
+  slave->TraceConnectWithoutContext ("MacRx",
+      MakeCallback (&BleTestCase12::Received, this));
+
+  // 100 ms connection interval
+  master->GetBBManager ()->CreateLinkScheduled (slave->GetBBManager (),
+      BleLinkManager::Role::MASTER_ROLE, true, 0, 80);
+  Ptr<BleLinkManager> masterLm =
+    master->GetBBManager ()->GetLinkManager (slave->GetAddress16 ());
+  Ptr<BleLinkManager> slaveLm =
+    slave->GetBBManager ()->GetLinkManager (master->GetAddress16 ());
+  NS_TEST_ASSERT_MSG_NE (masterLm, 0, "No link manager at the master");
+  NS_TEST_ASSERT_MSG_NE (slaveLm, 0, "No link manager at the slave");
+  masterLm->SetAttribute ("IdleFastForward", BooleanValue (true));
+
+  Simulator::Schedule (Seconds (5), &BleNetDevice::SendFrom, master,
+      Create<Packet> (20), master->GetAddress (), slave->GetAddress (), 1);
+  Simulator::Stop (Seconds (10));
+  Simulator::Run ();
+
+  // Only the first events of each idle period are simulated
+  NS_TEST_ASSERT_MSG_GT (masterLm->GetFastForwardedEvents (), 50,
+      "An idle link should be fast forwarded");
+  NS_TEST_ASSERT_MSG_EQ (masterLm->GetFastForwardedEvents (),
+      slaveLm->GetFastForwardedEvents (),
+      "Both ends should skip the same events");
+  Time emptyPdu = master->GetPhy ()->GetAirtime (
+      BleMacHeader ().GetSerializedSize ());
+  NS_TEST_ASSERT_MSG_GT (masterLm->GetFastForwardedAirtime (), Time (0),
+      "Fast forwarded events should account for their airtime");
+  NS_TEST_ASSERT_MSG_EQ (masterLm->GetFastForwardedAirtime (),
+      emptyPdu * int64_t (2 * masterLm->GetFastForwardedEvents ()),
+      "Every skipped event sends and receives one empty packet");
+  NS_TEST_ASSERT_MSG_EQ (m_received, 1,
+      "Data enqueued during the fast forward should be delivered");
+
+  Simulator::Destroy ();
+}
+
+// Checks channel selection algorithm #2 against the sample data of the Core
+// spec v5.0 (Vol 6, Part C, 3), and the hop table of a link across 256
+// event blocks and a channel map update
+class BleTestCase13 : public TestCase
+{
+public:
+  BleTestCase13 ();
+  virtual ~BleTestCase13 ();
+
+private:
+  virtual void DoRun (void);
+};
+
+BleTestCase13::BleTestCase13 ()
+  : TestCase ("Ble test case for channel selection algorithm #2")
+{
+}
+
+BleTestCase13::~BleTestCase13 ()
+{
+}
+
+void
+BleTestCase13::DoRun (void)
+{
+  // Access address 0x8E89BED6: channel identifier 0x305F
+  uint16_t channelIdentifier = 0x305F;
+  std::vector<uint8_t> allChannels;
+  for (uint8_t i = 0; i < 37; i++)
+    {
+      allChannels.push_back (i);
+    }
+  std::vector<uint8_t> nineChannels = {9, 10, 21, 22, 23, 33, 34, 35, 36};
+
+  // Sample data 1: all 37 channels used
+  uint8_t allExpected[4] = {25, 20, 6, 21};
+  for (uint16_t counter = 0; counter < 4; counter++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t) BleLinkManager::GetCsa2Channel (
+          counter, channelIdentifier, allChannels),
+          (uint32_t) allExpected[counter],
+          "Wrong channel with 37 channels, counter " << counter);
+    }
+  // Sample data 2: 9 channels used, counter 6 is mapped directly, 
+  // 7 and 8 are remapped
+  uint8_t nineExpected[3] = {23, 9, 34};
+  for (uint16_t counter = 6; counter < 9; counter++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t) BleLinkManager::GetCsa2Channel (
+          counter, channelIdentifier, nineChannels),
+          (uint32_t) nineExpected[counter - 6],
+          "Wrong channel with 9 channels, counter " << counter);
+    }
+  // The same map, unsorted and with channels listed twice
+  std::vector<uint8_t> duplicated = {36, 9, 22, 10, 9, 21, 23, 33, 34, 35, 22};
+  for (uint16_t counter = 6; counter < 9; counter++)
+    {
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t) BleLinkManager::GetCsa2Channel (
+          counter, channelIdentifier, duplicated),
+          (uint32_t) nineExpected[counter - 6],
+          "Duplicate channels change the channel, counter " << counter);
+    }
+
+  // The hop table of a link follows the same sequence, across the 256
+  // event blocks and after the channel map changes, also to a map with
+  // duplicate channels
+  BleHelper helper;
+  NodeContainer nodes;
+  nodes.Create (2);
+  helper.SetChannel (CreateObject<SingleModelSpectrumChannel> ());
+  NetDeviceContainer devices = helper.Install (nodes);
+  Ptr<BleNetDevice> master = DynamicCast<BleNetDevice> (devices.Get (0));
+  Ptr<BleNetDevice> slave = DynamicCast<BleNetDevice> (devices.Get (1));
+  master->SetAddress (Mac16Address ("00:01"));
+  slave->SetAddress (Mac16Address ("00:02"));
+  Ptr<BleLink> link = master->GetBBManager ()->CreateLinkScheduled (
+      slave->GetBBManager (), BleLinkManager::Role::MASTER_ROLE, true, 0, 80);
+  link->SetAccessAddress (0x8E89BED6);
+  Ptr<BleLinkManager> lm =
+    master->GetBBManager ()->GetLinkManager (slave->GetAddress16 ());
+  NS_TEST_ASSERT_MSG_NE (lm, 0, "No link manager at the master");
+  lm->SetAttribute ("ChannelSelection", EnumValue (BleLinkManager::CSA_2));
+  lm->SetUsedChannels (allChannels);
+  for (uint32_t counter = 0; counter < 600; counter++)
+    {
+      if (counter == 300)
+        {
+          lm->SetUsedChannels (nineChannels);
+        }
+      else if (counter == 450)
+        {
+          lm->SetUsedChannels (duplicated);
+        }
+      const std::vector<uint8_t> &used = 
+        counter < 300 ? allChannels : nineChannels;
+      lm->ManageChannelSelection ();
+      NS_TEST_ASSERT_MSG_EQ ((uint32_t) lm->GetCurrentChannelIndex (),
+          (uint32_t) BleLinkManager::GetCsa2Channel (counter,
+              channelIdentifier, used),
+          "Hop table differs at counter " << counter);
+    }
+
+  Simulator::Destroy ();
+}
+
+// Checks that moving a node drops the cached path losses of its pairs at
+// both ends, so the cache stays bounded and follows the new position
+class BleTestCase14 : public TestCase
+{
+public:
+  BleTestCase14 ();
+  virtual ~BleTestCase14 ();
+
+  void PathLoss (Ptr<const SpectrumPhy> txPhy, Ptr<const SpectrumPhy> rxPhy,
+                 double lossDb);
+private:
+  virtual void DoRun (void);
+
+  /**
+   * Transmit a BLE signal on channel 0.
+   *
+   * \param phy the sender
+   */
+  void Send (Ptr<BlePhy> phy);
+
+  Ptr<BleSpectrumChannel> m_channel; //!< the channel under test
+  std::map<std::pair<const SpectrumPhy *, const SpectrumPhy *>, double>
+    m_losses; //!< last path loss (dB) per sender and receiver
+};
+
+BleTestCase14::BleTestCase14 ()
+  : TestCase ("Ble test case for the path loss cache")
+{
+}
+
+BleTestCase14::~BleTestCase14 ()
+{
+}
+
+void
+BleTestCase14::PathLoss (Ptr<const SpectrumPhy> txPhy,
+                         Ptr<const SpectrumPhy> rxPhy, double lossDb)
+{
+  m_losses[std::make_pair (PeekPointer (txPhy), PeekPointer (rxPhy))] =
+    lossDb;
+}
+
+void
+BleTestCase14::Send (Ptr<BlePhy> phy)
+{
+  Ptr<BleSpectrumSignalParameters> params =
+    Create<BleSpectrumSignalParameters> ();
+  params->psd = Create<SpectrumValue> (BlePhy::GetSpectrumModel ());
+  params->duration = MicroSeconds (80);
+  params->packet = Create<Packet> (10);
+  params->txPhy = phy;
+  params->SetChannel (0);
+  m_channel->StartTx (params);
+}
+
+void
+BleTestCase14::DoRun (void)
+{
+  m_channel = CreateObject<BleSpectrumChannel> ();
+  m_channel->SetAttribute ("CachePathLoss", BooleanValue (true));
+  Ptr<LogDistancePropagationLossModel> loss =
+    CreateObject<LogDistancePropagationLossModel> ();
+  m_channel->AddPropagationLossModel (loss);
+  m_channel->TraceConnectWithoutContext ("PathLoss",
+      MakeCallback (&BleTestCase14::PathLoss, this));
+
+  Ptr<BlePhy> phys[3];
+  Ptr<ConstantPositionMobilityModel> mobility[3];
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      mobility[i] = CreateObject<ConstantPositionMobilityModel> ();
+      mobility[i]->SetPosition (Vector (10.0 * i, 0, 0));
+      phys[i] = CreateObject<BlePhy> ();
+      phys[i]->SetMobility (mobility[i]);
+      phys[i]->SetChannelIndex (0);
+      phys[i]->SetChannel (m_channel);
+    }
+
+  // The first two PHYs reach each other and the third: four pairs
+  uint32_t moves = 50;
+  for (uint32_t n = 0; n <= moves; n++)
+    {
+      if (n > 0)
+        {
+          mobility[1]->SetPosition (Vector (10.0 + n, 0, 0));
+        }
+      Send (phys[0]);
+      Send (phys[1]);
+      NS_TEST_ASSERT_MSG_EQ (m_channel->GetNCachedPathLosses (), 4,
+          "Wrong number of cached path losses after " << n << " moves");
+      NS_TEST_ASSERT_MSG_EQ (m_channel->GetNCachedPairEntries (), 8,
+          "Stale pairs are left behind after " << n << " moves");
+      for (uint32_t tx = 0; tx < 2; tx++)
+        {
+          for (uint32_t rx = 0; rx < 3; rx++)
+            {
+              if (rx == tx)
+                {
+                  continue;
+                }
+              double expected =
+                -loss->CalcRxPower (0, mobility[tx], mobility[rx]);
+              NS_TEST_ASSERT_MSG_EQ_TOL (m_losses[std::make_pair (
+                  PeekPointer (phys[tx]), PeekPointer (phys[rx]))],
+                  expected, 1e-9, "Path loss from " << tx << " to " << rx
+                  << " does not follow move " << n);
+            }
+        }
+    }
+
+  // Removing a PHY drops its pairs at both ends too
+  phys[1]->SetChannel (CreateObject<BleSpectrumChannel> ());
+  NS_TEST_ASSERT_MSG_EQ (m_channel->GetNCachedPathLosses (), 1,
+      "Only the pair from the first to the third PHY should be left");
+  NS_TEST_ASSERT_MSG_EQ (m_channel->GetNCachedPairEntries (), 2,
+      "Pairs of a removed PHY are left behind");
+
+  Simulator::Destroy ();
+  m_channel->Dispose ();
+  m_channel = 0;
+}
+
 // The TestSuite class names the TestSuite, identifies what type of TestSuite,
 // and enables the TestCases to be run.  Typically, only the constructor for
 // this class must be defined
@@ -716,6 +1552,16 @@ BleTestSuite::BleTestSuite ()
   AddTestCase (new BleTestCase2, Duration::QUICK);
   AddTestCase (new BleTestCase3, Duration::QUICK);
   AddTestCase (new BleTestCase4, Duration::QUICK);
+  AddTestCase (new BleTestCase5, Duration::QUICK);
+  AddTestCase (new BleTestCase6, Duration::QUICK);
+  AddTestCase (new BleTestCase7, Duration::QUICK);
+  AddTestCase (new BleTestCase8, Duration::QUICK);
+  AddTestCase (new BleTestCase9, Duration::QUICK);
+  AddTestCase (new BleTestCase10, Duration::QUICK);
+  AddTestCase (new BleTestCase11, Duration::QUICK);
+  AddTestCase (new BleTestCase12, Duration::QUICK);
+  AddTestCase (new BleTestCase13, Duration::QUICK);
+  AddTestCase (new BleTestCase14, Duration::QUICK);
 }
 
 // Do not forget to allocate an instance of this TestSuite